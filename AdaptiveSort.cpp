@@ -0,0 +1,75 @@
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <chrono>
+#include <algorithm>
+
+#include "adaptive_sort.hpp"
+
+using namespace std::chrono;
+
+/**
+ * Función principal del programa.
+ *
+ * @param argc Número de argumentos (entre 5 y 10).
+ * @param argv Argumentos:
+ *    [1] archivo de entrada,
+ *    [2] archivo de salida,
+ *    [3] N_bytes: tamaño total del archivo de entrada en bytes,
+ *    [4] M_bytes: memoria disponible en bytes,
+ *    [5] (opcional) aridad de MergeSort o particiones de QuickSort, o "auto" (por
+ *        defecto) para ajustarla según el algoritmo elegido (ver autotune.hpp),
+ *    [6] (opcional) cantidad de hilos para ordenar en memoria,
+ *    [7] (opcional) archivo donde escribir el reporte JSON de métricas por fase ("-" para
+ *        no escribirlo),
+ *    [8] (opcional) almacenamiento: "stdio" (por defecto), "direct", "pread", "mmap" o un
+ *        disco simulado "sim:..." (ver block_device.hpp),
+ *    [9] (opcional) directorios de espacio temporal (ver scratch_space.hpp).
+ *
+ * Sondea la entrada y elige entre ordenar en memoria, mezclar los runs que ya tiene,
+ * MergeSort o QuickSort (ver adaptive_sort.hpp).
+ *
+ * @return 0 si termina exitosamente, 1 en caso de error.
+ */
+int main(int argc, char* argv[]) {
+    if (argc < 5 || argc > 10) {
+        fprintf(stderr, "Uso: %s <archivo_entrada> <archivo_salida> <N_bytes> <M_bytes> [aridad|auto] [hilos] [reporte_json|-] [stdio|direct|sim:...] [dir,dir,...]\n", argv[0]);
+        return 1;
+    }
+
+    std::string input_file = argv[1];
+    std::string output_file = argv[2];
+    int64_t N = atoll(argv[3]) / ELEMENT_SIZE;
+    int64_t M = atoll(argv[4]) / ELEMENT_SIZE;
+    int64_t a = 0;
+    if (argc >= 6 && std::string(argv[5]) != "auto") a = std::max(2LL, atoll(argv[5]));
+    if (argc >= 7) sort_threads = std::max(1, atoi(argv[6]));
+    if (argc >= 9 && !parse_block_device(argv[8])) {
+        fprintf(stderr, "[ERROR] Almacenamiento desconocido: %s\n", argv[8]);
+        return 1;
+    }
+    if (argc >= 10 && !parse_scratch_dirs(argv[9])) {
+        fprintf(stderr, "[ERROR] Directorios temporales inválidos: %s\n", argv[9]);
+        return 1;
+    }
+
+    auto start = high_resolution_clock::now();
+    SortStrategy strategy = adaptive_sort(input_file, output_file, N, M, a);
+    auto end = high_resolution_clock::now();
+    block_device().persist(output_file);
+
+    auto duration = duration_cast<milliseconds>(end - start);
+
+    printf("Estrategia: %s\n", strategy_name(strategy));
+    printf("Tiempo total: %ld ms\n", (long)duration.count());
+    printf("I/Os totales: %ld (lecturas: %ld, escrituras: %ld)\n",
+        total_read_io + total_write_io, total_read_io, total_write_io);
+    if (strategy == SortStrategy::NATURAL || strategy == SortStrategy::MERGESORT) {
+        printf("Runs: %ld, pasadas de mezcla: %ld\n", total_runs, total_merge_passes);
+    }
+    print_block_device_summary();
+    if (argc >= 8 && std::string(argv[7]) != "-" && metrics.write_json(argv[7])) printf("Reporte de métricas: %s\n", argv[7]);
+
+    return 0;
+}
@@ -0,0 +1,1016 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <functional>
+
+#include "sort_common.hpp"
+#include "metrics.hpp"
+#include "block_device.hpp"
+#include "async_io.hpp"
+#include "io_engine.hpp"
+#include "scratch_space.hpp"
+#include "packed_run.hpp"
+#include "parallel_sort.hpp"
+#include "memory_sort.hpp"
+#include "memory_arena.hpp"
+#include "autotune.hpp"
+
+// Cantidad de runs generados y de pasadas de mezcla realizadas
+inline long total_runs = 0, total_merge_passes = 0;
+
+// Bloques de cada buffer de la mezcla (uno por run, lectura anticipada y salida)
+inline int64_t merge_buffer_blocks = 1;
+
+// Bloques de una mezcla de 2 vías completa: dos runs, lectura anticipada y dos de salida
+const int64_t MERGE_FULL_BLOCKS = 5;
+
+// Si la mezcla usa un solo buffer de salida y no lee por adelantado, para caber en
+// memorias de menos de MERGE_FULL_BLOCKS bloques (ver fit_merge_buffers)
+inline bool merge_lean = false;
+
+// Memoria mínima de mergesort_external con datos que no caben en ella, en bloques: una
+// mezcla de 2 vías sin doble buffer ni lectura anticipada
+const int64_t MERGESORT_MIN_BLOCKS = 3;
+
+/**
+ * Ajusta los buffers de la mezcla a M elementos: limita `merge_buffer_blocks` para que
+ * una mezcla de 2 vías completa (dos runs, lectura anticipada y dos de salida) quepa en
+ * M y, si ni con buffers de un bloque cabe, activa `merge_lean`.
+ */
+inline void fit_merge_buffers(int64_t M) {
+    merge_buffer_blocks = std::max<int64_t>(1, std::min(merge_buffer_blocks, M / (MERGE_FULL_BLOCKS * ELEMENTS_PER_BLOCK)));
+    merge_lean = M < MERGE_FULL_BLOCKS * ELEMENTS_PER_BLOCK;
+}
+
+// Buffers de la mezcla además de los de los runs: lectura anticipada y dos de salida, o
+// solo uno de salida en una mezcla reducida
+inline int64_t merge_extra_buffers(bool lean) {
+    return lean ? 1 : 3;
+}
+
+// Estrategias de formación de runs de mergesort_external
+enum class RunFormation {
+    REPLACEMENT_SELECTION,  // Selección por reemplazo: runs de ~2M elementos
+    SORTED_CHUNKS           // Trozos de M elementos ordenados en memoria
+};
+
+/**
+ * Ordena en memoria un archivo binario.
+ * 
+ * @param input_file Nombre del archivo de entrada con los datos a ordenar.
+ * @param output_file Nombre del archivo donde se guardarán los datos ordenados.
+ * @param N Número total de elementos (int64_t) a ordenar.
+ * 
+ * Esta función lee el archivo en bloques, los carga en un buffer tomado de
+ * `memory_arena`, los ordena en memoria usando `memory_sort` y los escribe al archivo
+ * de salida. El auxiliar del ordenamiento se toma solo si cabe en lo que queda del
+ * presupuesto; si no, se ordena sin él.
+ *
+ * Si el almacenamiento permite proyectar archivos (backend "mmap"), la entrada se lee
+ * directamente en la proyección del archivo de salida preasignado y se ordena ahí
+ * mismo, sin pasar por un buffer ni escribir la salida aparte.
+ */
+inline void sort_in_memory(const std::string& input_file, const std::string& output_file, int64_t N) {
+    auto f = block_device().open(input_file, OpenMode::READ);
+    auto out = block_device().open(output_file, OpenMode::CREATE);
+    ArenaScope scope;
+
+    std::unique_ptr<MappedRange> mapping;
+    if (out->mappable() && N > 0) {
+        out->truncate(N * ELEMENT_SIZE);
+        mapping = out->map(0, N * ELEMENT_SIZE);
+    }
+
+    int64_t* buf = mapping ? (int64_t*)mapping->data() : memory_arena.allocate(N);
+    for (int64_t i = 0; i < N; i += ELEMENTS_PER_BLOCK) {
+        int64_t chunk = std::min(ELEMENTS_PER_BLOCK, N - i);
+        f->read(&buf[i], chunk * ELEMENT_SIZE);
+        read_io++;
+    }
+    f.reset();
+
+    bool use_scratch = memory_sort_uses_scratch(N) && memory_arena.available() >= (size_t)N;
+    memory_sort(buf, N, use_scratch ? memory_arena.allocate(N) : nullptr);
+
+    if (mapping) {
+        mapping->sync();
+        write_io += (N + ELEMENTS_PER_BLOCK - 1) / ELEMENTS_PER_BLOCK;
+        return;
+    }
+    for (int64_t i = 0; i < N; i += ELEMENTS_PER_BLOCK) {
+        int64_t chunk = std::min(ELEMENTS_PER_BLOCK, N - i);
+        out->write(&buf[i], chunk * ELEMENT_SIZE);
+        write_io++;
+    }
+}
+
+// Operaciones de E/S realizadas por una mezcla, para sumarlas desde el hilo principal
+struct IOCount {
+    long reads = 0, writes = 0;
+};
+
+/**
+ * Retorna la memoria (en elementos) que necesita `merge_ranges` para mezclar k runs:
+ * un buffer por run, uno de lectura anticipada y dos de salida (solo uno de salida si
+ * `merge_lean`), cada uno de `merge_buffer_blocks` bloques.
+ */
+inline int64_t merge_memory(size_t k) {
+    return (k + merge_extra_buffers(merge_lean)) * merge_buffer_blocks * ELEMENTS_PER_BLOCK;
+}
+
+/**
+ * Retorna la mayor aridad cuya mezcla (`merge_memory`) cabe en M elementos, o 2 si no cabe ninguna.
+ */
+inline int64_t max_merge_arity(int64_t M) {
+    bool lean = M < MERGE_FULL_BLOCKS * ELEMENTS_PER_BLOCK;
+    return std::max<int64_t>(M / (merge_buffer_blocks * ELEMENTS_PER_BLOCK) - merge_extra_buffers(lean), 2);
+}
+
+/**
+ * Mezcla un tramo de cada uno de varios archivos ordenados y escribe el resultado a
+ * partir de una posición dada de un archivo de salida.
+ * 
+ * @param input_files Vector de nombres de archivos que ya están ordenados individualmente.
+ *                    Un nombre puede repetirse (varios tramos de un mismo archivo): se
+ *                    abre una sola vez y se lee por posición.
+ * @param begin Posición (en elementos) donde empieza el tramo de cada archivo.
+ * @param end Posición (en elementos) donde termina el tramo de cada archivo (exclusiva).
+ * @param out Archivo de salida.
+ * @param out_offset Posición (en elementos) del archivo de salida donde se escribe el resultado.
+ * @param memory Memoria para los buffers, de `merge_memory(k)` elementos.
+ * @param out_map Proyección en memoria de todo el archivo de salida, o nullptr. Si se
+ *                da, la mezcla escribe directamente en ella en vez de usar buffers de salida.
+ *
+ * @return Cantidad de bloques leídos y escritos.
+ * 
+ * Usa un árbol de perdedores (torneo) para realizar la fusión de k-vías: cada nodo
+ * interno guarda el run que perdió el partido en ese nodo y la raíz guarda al ganador,
+ * de modo que emitir un elemento solo requiere repetir los partidos del camino de la
+ * hoja del ganador a la raíz (log2(k) comparaciones). Si un mismo run gana dos veces
+ * seguidas, se calcula el mínimo de los demás runs y se copia directamente el tramo de
+ * ese run que no lo supera, sin pasar por el árbol.
+ * Se leen y escriben los datos en buffers de `merge_buffer_blocks` bloques, así que un
+ * buffer más grande hace menos accesos aleatorios por run. La E/S pasa por un
+ * `IOEngine`: la primera carga de los k buffers se envía en un solo lote, cada bloque de
+ * salida lleno se escribe mientras se llena el siguiente, y se lee por adelantado el
+ * próximo bloque del run que se agotará primero (pronóstico: el run cuyo último elemento
+ * en memoria es el menor). Con `merge_lean` no hay lectura anticipada y cada bloque de
+ * salida se escribe antes de seguir llenándolo. No modifica estado global, así que
+ * varias mezclas pueden correr a la vez en hilos distintos.
+ */
+inline IOCount merge_ranges(const std::vector<std::string>& input_files, const std::vector<int64_t>& begin,
+                            const std::vector<int64_t>& end, BlockFile* out, int64_t out_offset, int64_t* memory,
+                            int64_t* out_map = nullptr) {
+    IOCount count;
+    size_t k = input_files.size();
+    if (k == 0) return count;
+    const int64_t buf_elems = merge_buffer_blocks * ELEMENTS_PER_BLOCK;
+    auto blocks = [](int64_t n) { return (n + ELEMENTS_PER_BLOCK - 1) / ELEMENTS_PER_BLOCK; };
+
+    // Cada archivo distinto se abre una sola vez: la mezcla natural lee k tramos de la entrada
+    std::map<std::string, std::unique_ptr<BlockFile>> opened;
+    std::vector<BlockFile*> inputs(k);
+    std::vector<int64_t*> buffers(k);
+    std::vector<size_t> buffer_pos(k, 0);
+    std::vector<size_t> buffer_size(k, 0);
+    std::vector<int64_t> remaining(k);
+    std::vector<int64_t> read_pos(k);
+    std::vector<int64_t> last_key(k);
+
+    for (size_t i = 0; i < k; i++) {
+        auto& file = opened[input_files[i]];
+        if (!file) file = open_run(input_files[i], OpenMode::READ);
+        inputs[i] = file.get();
+        read_pos[i] = begin[i];
+        remaining[i] = end[i] - begin[i];
+        buffers[i] = memory + i * buf_elems;
+    }
+
+    IOEngine io;
+
+    // Encarga la lectura del próximo tramo del run i (a lo más buf_elems elementos) en dst
+    auto queue_read = [&](size_t i, int64_t* dst) {
+        size_t n = std::min(buf_elems, remaining[i]);
+        uint64_t ticket = io.read(inputs[i], dst, n * ELEMENT_SIZE, read_pos[i] * ELEMENT_SIZE);
+        read_pos[i] += n;
+        remaining[i] -= n;
+        return ticket;
+    };
+
+    // Doble buffer de salida: uno se llena mientras el otro se escribe en segundo plano
+    const bool lean = merge_lean;
+    int64_t* out_buffers[2] = {memory + k * buf_elems, memory + (k + 1) * buf_elems};
+    if (lean) out_buffers[1] = out_buffers[0];
+    if (out_map) out_buffers[0] = out_map + out_offset;
+    uint64_t out_tickets[2] = {0, 0};
+    int out_idx = 0;
+    size_t out_size = 0;
+    int64_t out_pos = out_offset;
+
+    auto flush_output = [&]() {
+        if (out_size > 0 && out_map) {
+            count.writes += blocks(out_size);
+            out_pos += out_size;
+            out_size = 0;
+            out_buffers[0] = out_map + out_pos;
+        } else if (out_size > 0) {
+            const int64_t* data = out_buffers[out_idx];
+            size_t n = out_size;
+            out_tickets[out_idx] = io.write(out, data, n * ELEMENT_SIZE, out_pos * ELEMENT_SIZE);
+            io.submit();
+            count.writes += blocks(n);
+            out_pos += n;
+            out_size = 0;
+            if (!lean) out_idx ^= 1;
+            io.wait(out_tickets[out_idx]);
+            out_tickets[out_idx] = 0;
+        }
+    };
+
+    auto emit_range = [&](const int64_t* src, size_t n) {
+        while (n > 0) {
+            size_t chunk = std::min(n, (size_t)buf_elems - out_size);
+            memcpy(&out_buffers[out_idx][out_size], src, chunk * ELEMENT_SIZE);
+            out_size += chunk;
+            src += chunk;
+            n -= chunk;
+            if (out_size == (size_t)buf_elems) flush_output();
+        }
+    };
+
+    // Lectura anticipada por pronóstico: un único buffer extra se llena en segundo plano
+    // para el run cuyo último elemento en memoria es el menor, que es el que se agotará primero.
+    int64_t* spare = lean ? nullptr : memory + (k + 2) * buf_elems;
+    size_t prefetch_run = k;
+    uint64_t prefetch_ticket = 0;
+
+    auto schedule_prefetch = [&]() {
+        if (lean || prefetch_run != k) return;
+        size_t target = k;
+        for (size_t i = 0; i < k; i++) {
+            if (remaining[i] > 0 && (target == k || last_key[i] < last_key[target])) target = i;
+        }
+        if (target == k) return;
+        prefetch_run = target;
+        prefetch_ticket = queue_read(target, spare);
+        io.submit();
+    };
+
+    // Deja en buffers[i] el próximo tramo del run i, ya leído (ticket) o por leer
+    auto load_block = [&](size_t i, uint64_t ticket) {
+        if (prefetch_run == i) {
+            buffer_size[i] = io.wait(prefetch_ticket) / ELEMENT_SIZE;
+            std::swap(buffers[i], spare);
+            prefetch_run = k;
+        } else {
+            if (ticket == 0 && remaining[i] > 0) ticket = queue_read(i, buffers[i]);
+            buffer_size[i] = io.wait(ticket) / ELEMENT_SIZE;
+        }
+        if (buffer_size[i] > 0) {
+            count.reads += blocks(buffer_size[i]);
+            last_key[i] = buffers[i][buffer_size[i] - 1];
+        } else {
+            remaining[i] = 0;
+        }
+        buffer_pos[i] = 0;
+    };
+
+    // Primera carga de todos los runs en un solo lote
+    std::vector<uint64_t> first_reads(k, 0);
+    for (size_t i = 0; i < k; i++) {
+        if (remaining[i] > 0) first_reads[i] = queue_read(i, buffers[i]);
+    }
+    io.submit();
+    for (size_t i = 0; i < k; i++) load_block(i, first_reads[i]);
+    schedule_prefetch();
+
+    auto refill = [&](size_t i) {
+        load_block(i, 0);
+        schedule_prefetch();
+        return buffer_size[i] > 0;
+    };
+
+    // key[i] es la cabeza del run i; done[i] indica que el run se agotó
+    std::vector<int64_t> key(k);
+    std::vector<char> done(k, 0);
+
+    auto advance = [&](size_t i) {
+        if (buffer_pos[i] == buffer_size[i] && (buffer_size[i] == 0 || !refill(i))) {
+            done[i] = 1;
+            return;
+        }
+        key[i] = buffers[i][buffer_pos[i]++];
+    };
+
+    // i le gana a j si su cabeza es menor, o igual y j ya se agotó
+    auto beats = [&](size_t i, size_t j) {
+        return !done[i] && (done[j] || key[i] < key[j]);
+    };
+
+    for (size_t i = 0; i < k; i++) {
+        if (buffer_size[i] > 0) key[i] = buffers[i][buffer_pos[i]++];
+        else done[i] = 1;
+    }
+
+    // tree[n] guarda el perdedor del nodo n (hojas implícitas en k..2k-1), tree[0] al ganador
+    std::vector<size_t> tree(k);
+    {
+        std::vector<size_t> winners(2 * k);
+        for (size_t i = 0; i < k; i++) winners[k + i] = i;
+        for (size_t n = k - 1; n >= 1; n--) {
+            size_t l = winners[2 * n], r = winners[2 * n + 1];
+            if (beats(l, r)) {
+                winners[n] = l;
+                tree[n] = r;
+            } else {
+                winners[n] = r;
+                tree[n] = l;
+            }
+        }
+        tree[0] = winners[1];
+    }
+
+    size_t prev = k;
+    while (true) {
+        size_t w = tree[0];
+        if (done[w]) break;
+        emit_range(&key[w], 1);
+
+        if (w == prev) {
+            // Tramo rápido: el mínimo de los demás runs está entre los perdedores del camino de w
+            size_t runner_up = k;
+            for (size_t n = (k + w) / 2; n > 0; n /= 2) {
+                if (runner_up == k || beats(tree[n], runner_up)) runner_up = tree[n];
+            }
+            bool bounded = runner_up != k && !done[runner_up];
+            int64_t limit = bounded ? key[runner_up] : 0;
+
+            while (true) {
+                const int64_t* buf = buffers[w];
+                size_t p = buffer_pos[w], e = buffer_size[w];
+                if (bounded) {
+                    size_t q = p;
+                    while (q < e && buf[q] <= limit) q++;
+                    e = q;
+                }
+                emit_range(buf + p, e - p);
+                buffer_pos[w] = e;
+                if (e < buffer_size[w] || !refill(w)) break;
+            }
+        }
+
+        advance(w);
+        for (size_t n = (k + w) / 2, cur = w; ; n /= 2) {
+            if (n == 0) {
+                tree[0] = cur;
+                break;
+            }
+            if (beats(tree[n], cur)) std::swap(tree[n], cur);
+        }
+        prev = w;
+    }
+
+    flush_output();
+    io.drain();
+    return count;
+}
+
+
+/**
+ * Lee el elemento en la posición `pos` de un archivo de enteros. Cuenta como la lectura
+ * de un bloque, así que solo debe llamarse desde el hilo principal.
+ */
+inline int64_t read_element_at(BlockFile* f, int64_t pos) {
+    int64_t val = 0;
+    read_io++;
+    f->read_at(&val, ELEMENT_SIZE, pos * ELEMENT_SIZE);
+    return val;
+}
+
+/**
+ * Busca en un archivo ordenado la primera posición cuyo elemento es mayor o igual a `key`.
+ *
+ * @param f Archivo ordenado.
+ * @param n Cantidad de elementos del archivo.
+ * @param key Clave buscada.
+ *
+ * @return Posición encontrada, entre 0 y n. Hace log2(n) lecturas de un elemento.
+ */
+inline int64_t lower_bound_on_disk(BlockFile* f, int64_t n, int64_t key) {
+    int64_t lo = 0, hi = n;
+    while (lo < hi) {
+        int64_t mid = lo + (hi - lo) / 2;
+        if (read_element_at(f, mid) < key) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// Elementos mínimos por hilo para que convenga mezclar en paralelo
+const int64_t PARALLEL_MERGE_MIN = 1 << 20;
+
+// Muestras que se toman de cada run para elegir las claves separadoras
+const int64_t SPLITTER_SAMPLES_PER_RUN = 64;
+
+/**
+ * Mezcla varios archivos ordenados en un solo archivo de salida ordenado.
+ * 
+ * @param input_files Vector de nombres de archivos que ya están ordenados individualmente.
+ * @param output_file Nombre del archivo donde se escribirá la mezcla final ordenada.
+ * @param threads Cantidad de hilos que mezclan a la vez.
+ * @param output_is_run Si la salida es un run intermedio (se escribe con `open_run`,
+ *   comprimido si `compress_runs` está activo, en un disco distinto de las entradas si
+ *   se puede) o la salida final (enteros de 8 bytes).
+ * 
+ * Con un hilo, mezcla todos los archivos completos con `merge_ranges`. Con p hilos,
+ * reparte la mezcla por rangos de clave: toma una muestra equiespaciada de cada run,
+ * elige p-1 claves separadoras entre sus cuantiles y ubica cada separadora en cada run
+ * con búsqueda binaria sobre el disco. El hilo t mezcla los elementos con clave entre
+ * la separadora t-1 y la t de todos los runs; como la cantidad de elementos menores a
+ * su rango es conocida, escribe su parte directamente en esa posición del archivo de
+ * salida (preasignado) con `write_at`, sin coordinarse con los demás. Los buffers de
+ * cada hilo salen de `memory_arena`, así que se usan solo los hilos que caben en ella.
+ * Si el almacenamiento permite proyectar archivos, la salida se preasigna y se proyecta
+ * en memoria, y cada hilo escribe la mezcla directamente en ella.
+ */
+inline void merge_external(const std::vector<std::string>& input_files, const std::string& output_file, unsigned threads = 1,
+                           bool output_is_run = false) {
+    size_t k = input_files.size();
+    std::vector<std::unique_ptr<BlockFile>> inputs(k);
+    std::vector<int64_t> sizes(k);
+    int64_t total = 0;
+    for (size_t i = 0; i < k; i++) {
+        inputs[i] = open_run(input_files[i], OpenMode::READ);
+        sizes[i] = inputs[i]->size() / ELEMENT_SIZE;
+        total += sizes[i];
+    }
+
+    auto out = output_is_run ? open_run(output_file, OpenMode::CREATE, input_files)
+                             : block_device().open(output_file, OpenMode::CREATE);
+    int64_t p = std::max<int64_t>(1, std::min<int64_t>(threads, total / PARALLEL_MERGE_MIN));
+    p = std::min<int64_t>(p, memory_arena.available() / merge_memory(k));
+    if (k <= 1 || p < 1) p = 1;
+
+    // bounds[t][i]: posición del run i donde empieza el rango del hilo t
+    std::vector<std::vector<int64_t>> bounds(p + 1, std::vector<int64_t>(k, 0));
+    bounds[p] = sizes;
+    if (p > 1) {
+        std::vector<int64_t> sample;
+        for (size_t i = 0; i < k; i++) {
+            int64_t samples = std::min(sizes[i], SPLITTER_SAMPLES_PER_RUN);
+            for (int64_t s = 0; s < samples; s++) {
+                sample.push_back(read_element_at(inputs[i].get(), sizes[i] * s / samples));
+            }
+        }
+        std::sort(sample.begin(), sample.end());
+        for (int64_t t = 1; t < p; t++) {
+            int64_t splitter = sample[sample.size() * t / p];
+            for (size_t i = 0; i < k; i++) bounds[t][i] = lower_bound_on_disk(inputs[i].get(), sizes[i], splitter);
+        }
+    }
+    inputs.clear();
+
+    // Con varios hilos o con la salida proyectada en memoria, la salida se preasigna
+    std::unique_ptr<MappedRange> mapping;
+    if (p > 1 || (out->mappable() && total > 0)) out->truncate(total * ELEMENT_SIZE);
+    if (out->mappable()) mapping = out->map(0, total * ELEMENT_SIZE);
+    int64_t* out_map = mapping ? (int64_t*)mapping->data() : nullptr;
+
+    ArenaScope scope;
+    int64_t* memory = memory_arena.allocate(p * merge_memory(k));
+    std::vector<IOCount> counts(p);
+    auto merge_part = [&](size_t t) {
+        int64_t offset = 0;
+        for (size_t i = 0; i < k; i++) offset += bounds[t][i];
+        counts[t] = merge_ranges(input_files, bounds[t], bounds[t + 1], out.get(), offset, memory + t * merge_memory(k),
+                                 out_map);
+    };
+    if (p == 1) {
+        merge_part(0);
+    } else {
+        sort_pool().parallel_for(p, merge_part);
+    }
+    if (mapping) mapping->sync();
+    mapping.reset();
+    out.reset();
+
+    for (const auto& c : counts) {
+        read_io += c.reads;
+        write_io += c.writes;
+    }
+}
+
+/**
+ * Restaura la propiedad de min-heap bajando el elemento en la posición `i`.
+ *
+ * @param heap Arreglo que contiene el heap.
+ * @param n Cantidad de elementos del heap.
+ * @param i Posición del elemento a reubicar.
+ */
+static inline void sift_down(int64_t* heap, int64_t n, int64_t i) {
+    int64_t val = heap[i];
+    while (true) {
+        int64_t child = 2 * i + 1;
+        if (child >= n) break;
+        if (child + 1 < n && heap[child + 1] < heap[child]) child++;
+        if (heap[child] >= val) break;
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = val;
+}
+
+/**
+ * Genera runs ordenados a partir de un archivo usando selección por reemplazo.
+ *
+ * @param input_file Nombre del archivo de entrada (datos no ordenados).
+ * @param N Número total de elementos (int64_t) en el archivo de entrada.
+ * @param M Cantidad máxima de elementos que caben en memoria.
+ *
+ * @return Vector con los nombres de los runs generados, en orden de creación.
+ *
+ * Mantiene un min-heap que ocupa la memoria salvo un bloque de entrada y uno de salida,
+ * todo tomado de `memory_arena`. Cada mínimo extraído se escribe al run actual y
+ * se reemplaza por el siguiente elemento de la entrada: si este es mayor o igual al
+ * último escrito entra al heap del mismo run; si no, se guarda al final del arreglo
+ * para el run siguiente, achicando el heap. Cuando el heap queda vacío se cierra el run
+ * y los elementos guardados forman el heap del próximo. En entradas aleatorias los runs
+ * miden en promedio 2M elementos, y en entradas parcialmente ordenadas mucho más.
+ */
+inline std::vector<std::string> generate_runs(const std::string& input_file, int64_t N, int64_t M) {
+    std::vector<std::string> runs;
+    if (N <= 0) return runs;
+
+    auto f = block_device().open(input_file, OpenMode::READ);
+
+    ArenaScope scope;
+    int64_t capacity = std::min(N, std::max<int64_t>(M - 2 * ELEMENTS_PER_BLOCK, 1));
+    int64_t* heap = memory_arena.allocate(capacity);
+    for (int64_t i = 0; i < capacity; i += ELEMENTS_PER_BLOCK) {
+        int64_t chunk = std::min(ELEMENTS_PER_BLOCK, capacity - i);
+        f->read(&heap[i], chunk * ELEMENT_SIZE);
+        read_io++;
+    }
+    int64_t remaining = N - capacity;
+
+    // heap[0, heap_size) es el heap del run actual; heap[heap_size, capacity) espera al siguiente
+    int64_t heap_size = capacity;
+    std::make_heap(heap, heap + capacity, std::greater<int64_t>());
+
+    int64_t* in_buf = memory_arena.allocate(ELEMENTS_PER_BLOCK);
+    size_t in_pos = 0, in_size = 0;
+    int64_t* out_buf = memory_arena.allocate(ELEMENTS_PER_BLOCK);
+    int64_t out_size = 0;
+    std::unique_ptr<BlockFile> out;
+
+    auto start_run = [&]() {
+        std::string run_name = input_file + "_run_" + std::to_string(runs.size());
+        out = open_run(run_name, OpenMode::CREATE);
+        runs.push_back(run_name);
+    };
+
+    auto flush_run = [&]() {
+        if (out_size > 0) {
+            out->write(out_buf, out_size * ELEMENT_SIZE);
+            write_io++;
+            out_size = 0;
+        }
+    };
+
+    auto emit = [&](int64_t val) {
+        out_buf[out_size++] = val;
+        if (out_size == ELEMENTS_PER_BLOCK) flush_run();
+    };
+
+    start_run();
+    while (remaining > 0) {
+        if (heap_size == 0) {
+            flush_run();
+            heap_size = capacity;
+            std::make_heap(heap, heap + capacity, std::greater<int64_t>());
+            start_run();
+        }
+
+        if (in_pos == in_size) {
+            int64_t chunk = std::min(ELEMENTS_PER_BLOCK, remaining);
+            in_size = f->read(in_buf, chunk * ELEMENT_SIZE) / ELEMENT_SIZE;
+            read_io++;
+            in_pos = 0;
+            if (in_size == 0) break;
+        }
+        int64_t next = in_buf[in_pos++];
+        remaining--;
+
+        int64_t top = heap[0];
+        emit(top);
+        if (next >= top) {
+            heap[0] = next;
+        } else {
+            heap_size--;
+            heap[0] = heap[heap_size];
+            heap[heap_size] = next;
+        }
+        sift_down(heap, heap_size, 0);
+    }
+    f.reset();
+
+    // Fin de la entrada: lo que queda en el heap cierra el run actual y lo guardado forma el último
+    std::sort(heap, heap + heap_size);
+    for (int64_t i = 0; i < heap_size; i++) emit(heap[i]);
+    flush_run();
+
+    if (heap_size < capacity) {
+        start_run();
+        std::sort(heap + heap_size, heap + capacity);
+        for (int64_t i = heap_size; i < capacity; i++) emit(heap[i]);
+        flush_run();
+    }
+    out.reset();
+
+    return runs;
+}
+
+/**
+ * Genera runs ordenados leyendo la entrada en trozos y ordenando cada trozo en memoria.
+ *
+ * @param input_file Nombre del archivo de entrada (datos no ordenados).
+ * @param N Número total de elementos (int64_t) en el archivo de entrada.
+ * @param M Cantidad máxima de elementos que caben en memoria.
+ *
+ * @return Vector con los nombres de los runs generados, en orden de creación.
+ *
+ * Cada trozo se lee una sola vez, se ordena con `memory_sort` y se escribe directamente
+ * como run, sin archivos intermedios. Con varios hilos (`sort_threads`) se solapa el
+ * trabajo en una cañería: el hilo de E/S lee el trozo k+1 y escribe el trozo k-1
+ * mientras se ordena el trozo k, lo que requiere dos buffers de trozo. El tamaño de
+ * trozo es M dividido por la cantidad de buffers, contando el auxiliar del
+ * ordenamiento si el algoritmo elegido lo usa, y todos salen de `memory_arena`.
+ */
+inline std::vector<std::string> generate_sorted_runs(const std::string& input_file, int64_t N, int64_t M) {
+    std::vector<std::string> runs;
+    if (N <= 0) return runs;
+
+    auto f = block_device().open(input_file, OpenMode::READ);
+    BlockFile* in = f.get();
+
+    int num_bufs = sort_threads > 1 ? 2 : 1;
+    bool use_scratch = memory_sort_uses_scratch(std::min(N, M / (num_bufs + 1)));
+    int64_t chunk_size = std::min(N, std::max<int64_t>(M / (num_bufs + use_scratch), 1));
+    ArenaScope scope;
+    int64_t* bufs[2] = {nullptr, nullptr};
+    for (int i = 0; i < num_bufs; i++) bufs[i] = memory_arena.allocate(chunk_size);
+    int64_t* scratch = use_scratch ? memory_arena.allocate(chunk_size) : nullptr;
+    int64_t num_chunks = (N + chunk_size - 1) / chunk_size;
+
+    IOThread io;
+
+    auto blocks = [](int64_t n) { return (n + ELEMENTS_PER_BLOCK - 1) / ELEMENTS_PER_BLOCK; };
+
+    auto submit_read = [&](int64_t c) {
+        int64_t* dst = bufs[c % num_bufs];
+        int64_t n = std::min(chunk_size, N - c * chunk_size);
+        read_io += blocks(n);
+        return io.submit([=] {
+            for (int64_t j = 0; j < n; j += ELEMENTS_PER_BLOCK) {
+                in->read(dst + j, std::min(ELEMENTS_PER_BLOCK, n - j) * ELEMENT_SIZE);
+            }
+        });
+    };
+
+    uint64_t read_ticket = submit_read(0);
+    for (int64_t c = 0; c < num_chunks; c++) {
+        io.wait(read_ticket);
+        int64_t* buf = bufs[c % num_bufs];
+        int64_t current_size = std::min(chunk_size, N - c * chunk_size);
+        if (num_bufs > 1 && c + 1 < num_chunks) read_ticket = submit_read(c + 1);
+
+        memory_sort(buf, current_size, scratch);
+
+        std::string run_name = input_file + "_run_" + std::to_string(runs.size());
+        std::shared_ptr<BlockFile> out = open_run(run_name, OpenMode::CREATE);
+        write_io += blocks(current_size);
+        io.submit([=]() mutable {
+            for (int64_t j = 0; j < current_size; j += ELEMENTS_PER_BLOCK) {
+                out->write(buf + j, std::min(ELEMENTS_PER_BLOCK, current_size - j) * ELEMENT_SIZE);
+            }
+            out.reset();
+        });
+        runs.push_back(run_name);
+
+        if (num_bufs == 1 && c + 1 < num_chunks) read_ticket = submit_read(c + 1);
+    }
+    io.drain();
+    return runs;
+}
+
+/**
+ * Mezcla una lista de runs ordenados en pasadas sucesivas de a lo más `a` vías,
+ * hasta dejar un único archivo de salida ordenado.
+ *
+ * @param runs Nombres de los runs ordenados. Se eliminan a medida que se consumen.
+ * @param output_file Nombre del archivo donde se escribirá el resultado final.
+ * @param a Aridad máxima de cada mezcla.
+ * @param M Cantidad máxima de elementos que caben en memoria.
+ *
+ * @return Número de pasadas de mezcla realizadas sobre los datos.
+ *
+ * Cada pasada agrupa los runs de a `a` y mezcla cada grupo con `merge_external`, de modo
+ * que cada elemento se lee y escribe una sola vez por pasada. La aridad se limita a la
+ * cantidad de runs cuyos buffers (`merge_memory`) caben en M. Los runs viven en el
+ * espacio temporal (`scratch_device`), así que un único run también se copia a la salida
+ * (y se descomprime, si los runs están comprimidos).
+ */
+inline int merge_runs(std::vector<std::string> runs, const std::string& output_file, int64_t a, int64_t M) {
+    int passes = 0;
+    if (runs.empty()) {
+        block_device().open(output_file, OpenMode::CREATE);
+        return passes;
+    }
+
+    a = std::max<int64_t>(std::min<int64_t>(a, max_merge_arity(M)), 2);
+    while ((int64_t)runs.size() > a) {
+        PhaseTimer phase("mezcla", passes);
+        std::vector<std::string> next;
+        for (size_t i = 0; i < runs.size(); i += a) {
+            size_t end = std::min(runs.size(), i + (size_t)a);
+            if (end - i == 1) {
+                next.push_back(runs[i]);
+                continue;
+            }
+            std::vector<std::string> group(runs.begin() + i, runs.begin() + end);
+            std::string merged = output_file + "_pass_" + std::to_string(passes) + "_" + std::to_string(next.size());
+            merge_external(group, merged, 1, true);
+            for (const auto& run : group) scratch_device().remove(run);
+            next.push_back(merged);
+        }
+        runs = next;
+        passes++;
+    }
+
+    PhaseTimer phase("mezcla", passes);
+    merge_external(runs, output_file, sort_threads);
+    for (const auto& run : runs) scratch_device().remove(run);
+    return passes + 1;
+}
+
+/**
+ * Implementa el algoritmo de mergesort externo sobre archivos.
+ * 
+ * @param input_file Nombre del archivo de entrada (datos no ordenados).
+ * @param output_file Nombre del archivo de salida donde se guardarán los datos ordenados.
+ * @param N Número total de elementos (int64_t) en el archivo de entrada.
+ * @param M Cantidad máxima de elementos que caben en memoria (según M_bytes / ELEMENT_SIZE).
+ * @param a Aridad del algoritmo: número máximo de runs que se mezclan a la vez.
+ * @param formation Estrategia de formación de runs.
+ * 
+ * Si los datos caben en memoria, usa `sort_in_memory`.
+ * Si no, genera runs ordenados en una sola pasada, con selección por reemplazo
+ * (`generate_runs`) o por trozos ordenados (`generate_sorted_runs`), y los mezcla en
+ * pasadas de a lo más `a` vías (`merge_runs`). Cada elemento se lee y escribe una vez
+ * al formar los runs y una vez por pasada de mezcla. Toda la memoria de datos sale de
+ * `memory_arena`, que se reserva una sola vez con M elementos, y todos los runs viven en
+ * un único archivo de espacio temporal junto a la entrada (`ScratchSpace`).
+ *
+ * Los contadores read_io / write_io se reinician al comenzar y, al terminar, se suman
+ * una sola vez a total_read_io / total_write_io. Cada fase (orden en memoria,
+ * formación de runs y cada pasada de mezcla) se registra en `metrics`.
+ */
+inline void mergesort_external(const std::string& input_file, const std::string& output_file, int64_t N, int64_t M, int64_t a,
+                               RunFormation formation = RunFormation::REPLACEMENT_SELECTION) {
+
+    if (N > M && M < MERGESORT_MIN_BLOCKS * ELEMENTS_PER_BLOCK) {
+        fprintf(stderr, "[ERROR] Memoria insuficiente para MergeSort: se necesitan al menos %ld bloques\n",
+                (long)MERGESORT_MIN_BLOCKS);
+        exit(1);
+    }
+    memory_arena.init(M);
+    // Una mezcla de 2 vías debe caber en M
+    fit_merge_buffers(M);
+    read_io = 0;
+    write_io = 0;
+
+    if (N <= M) {
+        {
+            PhaseTimer phase("orden_en_memoria");
+            sort_in_memory(input_file, output_file, N);
+        }
+        total_read_io += read_io;
+        total_write_io += write_io;
+        return;
+    }
+
+    ScratchScope scratch(input_file);
+    std::vector<std::string> runs;
+    {
+        PhaseTimer phase("formacion_runs");
+        runs = formation == RunFormation::SORTED_CHUNKS
+            ? generate_sorted_runs(input_file, N, M)
+            : generate_runs(input_file, N, M);
+    }
+    total_runs = runs.size();
+    total_merge_passes = merge_runs(runs, output_file, a, M);
+
+    total_read_io += read_io;
+    total_write_io += write_io;
+}
+
+// I/Os, runs y pasadas que predice el modelo de costo de mergesort_external
+struct IOEstimate {
+    long reads = 0, writes = 0;
+    long runs = 0, passes = 0;
+};
+
+/**
+ * Estima el largo de los runs que forma mergesort_external, sin leer la entrada.
+ *
+ * @param N Número total de elementos.
+ * @param M Cantidad máxima de elementos que caben en memoria.
+ * @param formation Estrategia de formación de runs.
+ * @param B Elementos por bloque.
+ *
+ * Con trozos ordenados el resultado es exacto: usa el mismo tamaño de trozo que
+ * `generate_sorted_runs`. Con selección por reemplazo supone entrada aleatoria: el
+ * primer run mide en promedio (e - 1) veces el heap y los siguientes el doble del heap.
+ * Cuando la entrada se acaba a mitad de un run, habiendo leído x elementos en él, cerca
+ * de x/2 elementos ya están guardados para el run siguiente: el run actual termina con
+ * el resto del heap y los guardados forman un último run.
+ */
+inline std::vector<int64_t> estimate_run_lengths(int64_t N, int64_t M, RunFormation formation, int64_t B = ELEMENTS_PER_BLOCK) {
+    std::vector<int64_t> lengths;
+    if (formation == RunFormation::SORTED_CHUNKS) {
+        int num_bufs = sort_threads > 1 ? 2 : 1;
+        bool use_scratch = memory_sort_uses_scratch(std::min(N, M / (num_bufs + 1)));
+        int64_t chunk_size = std::min(N, std::max<int64_t>(M / (num_bufs + use_scratch), 1));
+        for (int64_t done = 0; done < N; done += chunk_size) lengths.push_back(std::min(chunk_size, N - done));
+        return lengths;
+    }
+
+    // Un run completo de largo L necesita que queden L elementos por leer además del heap
+    int64_t capacity = std::min(N, std::max<int64_t>(M - 2 * B, 1));
+    int64_t remaining = N;
+    int64_t len = std::max<int64_t>(1, capacity * 1718 / 1000);
+    while (remaining >= len + capacity) {
+        lengths.push_back(len);
+        remaining -= len;
+        len = 2 * capacity;
+    }
+    int64_t saved = std::max<int64_t>(0, remaining - capacity) / 2;
+    lengths.push_back(remaining - saved);
+    if (saved > 0) lengths.push_back(saved);
+    return lengths;
+}
+
+/**
+ * Cuenta las I/Os de una mezcla de `merge_external` sobre runs de los largos dados,
+ * repartida en los mismos hilos que usaría (con rangos de clave supuestos parejos).
+ */
+inline IOCount estimate_merge(const std::vector<int64_t>& lengths, unsigned threads, int64_t M, int64_t B) {
+    IOCount count;
+    auto blocks = [B](int64_t n) { return (n + B - 1) / B; };
+    int64_t k = lengths.size(), total = 0;
+    for (int64_t len : lengths) total += len;
+
+    int64_t p = std::max<int64_t>(1, std::min<int64_t>(threads, total / PARALLEL_MERGE_MIN));
+    p = std::min<int64_t>(p, M / ((k + merge_extra_buffers(M < MERGE_FULL_BLOCKS * B)) * merge_buffer_blocks * B));
+    if (k <= 1 || p < 1) p = 1;
+
+    // Muestra de separadoras y búsqueda binaria de cada una en cada run
+    if (p > 1) {
+        for (int64_t len : lengths) {
+            count.reads += std::min(len, SPLITTER_SAMPLES_PER_RUN);
+            for (int64_t t = 1; t < p; t++) {
+                for (int64_t n = len; n > 0; n /= 2) count.reads++;
+            }
+        }
+    }
+
+    for (int64_t t = 0; t < p; t++) {
+        int64_t part = 0;
+        for (int64_t len : lengths) {
+            int64_t n = len * (t + 1) / p - len * t / p;
+            count.reads += blocks(n);
+            part += n;
+        }
+        count.writes += blocks(part);
+    }
+    return count;
+}
+
+/**
+ * Modo de simulación de mergesort_external: recorre la misma secuencia de fases (orden
+ * en memoria, formación de runs y pasadas de mezcla de `merge_runs`) llevando solo el
+ * largo de cada run, y cuenta las I/Os de bloque que haría cada fase sin leer ni
+ * escribir datos. Tarda microsegundos, así que sirve para elegir parámetros.
+ *
+ * @param N Número total de elementos.
+ * @param M Cantidad máxima de elementos que caben en memoria.
+ * @param a Aridad del algoritmo.
+ * @param formation Estrategia de formación de runs.
+ * @param B Elementos por bloque.
+ *
+ * @return I/Os de lectura y escritura, runs y pasadas de mezcla predichos.
+ */
+inline IOEstimate mergesort_external_dry_run(int64_t N, int64_t M, int64_t a,
+                                             RunFormation formation = RunFormation::REPLACEMENT_SELECTION,
+                                             int64_t B = ELEMENTS_PER_BLOCK) {
+    IOEstimate est;
+    auto blocks = [B](int64_t n) { return (n + B - 1) / B; };
+    if (N <= 0) return est;
+
+    if (N <= M) {
+        est.reads = est.writes = blocks(N);
+        return est;
+    }
+
+    std::vector<int64_t> runs = estimate_run_lengths(N, M, formation, B);
+    est.runs = runs.size();
+    est.reads = blocks(N);
+    for (int64_t len : runs) est.writes += blocks(len);
+
+    a = std::max<int64_t>(std::min<int64_t>(a, M / (merge_buffer_blocks * B) - merge_extra_buffers(M < MERGE_FULL_BLOCKS * B)), 2);
+    while ((int64_t)runs.size() > a) {
+        std::vector<int64_t> next;
+        for (size_t i = 0; i < runs.size(); i += a) {
+            size_t end = std::min(runs.size(), i + (size_t)a);
+            std::vector<int64_t> group(runs.begin() + i, runs.begin() + end);
+            int64_t merged = 0;
+            for (int64_t len : group) merged += len;
+            if (group.size() > 1) {
+                IOCount c = estimate_merge(group, 1, M, B);
+                est.reads += c.reads;
+                est.writes += c.writes;
+            }
+            next.push_back(merged);
+        }
+        runs = next;
+        est.passes++;
+    }
+
+    // Un único run también se copia desde el espacio temporal a la salida
+    if (!runs.empty()) {
+        IOCount c = estimate_merge(runs, sort_threads, M, B);
+        est.reads += c.reads;
+        est.writes += c.writes;
+        est.passes++;
+    }
+    return est;
+}
+
+// Mayor buffer de mezcla (en bloques) que considera el ajuste automático
+const int64_t MAX_TUNED_BUFFER_BLOCKS = 64;
+
+// Parámetros de mezcla elegidos por `tune_mergesort`
+struct MergeTuning {
+    int64_t arity = 2;
+    int64_t buffer_blocks = 1;
+    double seconds = 0;  // Tiempo estimado del ordenamiento completo
+};
+
+/**
+ * Elige la aridad y el tamaño de los buffers de mezcla que minimizan el tiempo estimado
+ * de mergesort_external en el dispositivo descrito por `profile`.
+ *
+ * @param N Número total de elementos.
+ * @param M Cantidad máxima de elementos que caben en memoria.
+ * @param formation Estrategia de formación de runs.
+ * @param profile Perfil medido del directorio de archivos temporales.
+ *
+ * Para cada tamaño de buffer b (potencias de 2) y cada aridad que cabe en M, usa
+ * `mergesort_external_dry_run` para contar bloques y pasadas. En la mezcla cada buffer
+ * que se llena o se vacía es un acceso aleatorio, así que una aridad alta baja las
+ * pasadas pero, con M fijo, achica los buffers y multiplica los accesos; además cada
+ * elemento cuesta log2(a) comparaciones por pasada. No lee ni escribe datos.
+ */
+inline MergeTuning tune_mergesort(int64_t N, int64_t M, RunFormation formation, const DeviceProfile& profile) {
+    MergeTuning best;
+    if (N <= M) return best;
+
+    int64_t saved = merge_buffer_blocks;
+    int64_t formation_blocks = 2 * ((N + ELEMENTS_PER_BLOCK - 1) / ELEMENTS_PER_BLOCK);
+    bool found = false;
+    for (int64_t b = 1; b <= MAX_TUNED_BUFFER_BLOCKS && MERGE_FULL_BLOCKS * b * ELEMENTS_PER_BLOCK <= M; b *= 2) {
+        merge_buffer_blocks = b;
+        for (int64_t a = 2; a <= max_merge_arity(M); a++) {
+            IOEstimate est = mergesort_external_dry_run(N, M, a, formation);
+            double merge_blocks = std::max<double>(0, est.reads + est.writes - formation_blocks);
+            double fan_in = std::min<double>(a, est.runs);
+            double seconds = profile.seconds((double)(est.reads + est.writes) * BLOCK_SIZE, merge_blocks / b,
+                                             (double)N * std::log2(std::max(fan_in, 2.0)) * est.passes);
+            if (!found || seconds < best.seconds) {
+                best = {a, b, seconds};
+                found = true;
+            }
+            // Con a >= runs queda una sola pasada: aridades mayores no cambian nada
+            if (a >= est.runs) break;
+        }
+    }
+    merge_buffer_blocks = saved;
+    return best;
+}
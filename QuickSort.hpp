@@ -0,0 +1,544 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <algorithm>
+#include <random>
+#include <deque>
+#include <memory>
+#include <sys/uio.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include "sort_common.hpp"
+#include "metrics.hpp"
+#include "block_device.hpp"
+#include "io_engine.hpp"
+#include "scratch_space.hpp"
+#include "memory_sort.hpp"
+#include "memory_arena.hpp"
+#include "autotune.hpp"
+
+// Muestras por partición al elegir los pivotes (sobremuestreo)
+const int64_t PIVOT_OVERSAMPLING = 32;
+
+// Elementos que se toman de cada bloque leído para la muestra de pivotes
+const int64_t SAMPLES_PER_BLOCK = 32;
+
+// Memoria mínima de una distribución, en bloques: dos de lectura y un pool de cuatro,
+// uno por cada una de tres particiones (dos rangos y una de igualdad, sin la cual una
+// clave con más de M copias no se termina de repartir) más uno libre para cerrar un bloque
+const int64_t QUICKSORT_MIN_BLOCKS = 6;
+
+// Cantidad máxima de particiones de una distribución: BucketClassifier guarda el número
+// de partición en 16 bits
+const int64_t QUICKSORT_MAX_BUCKETS = UINT16_MAX;
+
+/**
+ * Retorna la cantidad máxima de particiones (contando las de igualdad) con un pool de
+ * `pool_blocks` bloques: dos bloques por partición, al menos 3 particiones si el pool lo
+ * permite y nunca más de pool_blocks - 1, porque cada partición retiene un bloque y
+ * cerrarlo requiere otro libre, ni más de QUICKSORT_MAX_BUCKETS. Un resultado menor que
+ * 3 indica que no alcanza la memoria.
+ */
+inline int quicksort_max_buckets(int64_t pool_blocks) {
+    int64_t buckets = std::min<int64_t>(std::max<int64_t>(3, pool_blocks / 2), pool_blocks - 1);
+    return (int)std::min(buckets, QUICKSORT_MAX_BUCKETS);
+}
+
+// Pivotes de una partición: pivots[i] tiene partición de igualdad propia si equal[i]
+struct Splitters {
+    std::vector<int64_t> pivots;
+    std::vector<char> equal;
+};
+
+/**
+ * Elige los pivotes de una partición a partir de una muestra de todo el archivo.
+ *
+ * Parámetros:
+ * @param input_file  Nombre del archivo de entrada.
+ * @param N           Número total de elementos del archivo.
+ * @param a           Número de particiones que se quiere formar.
+ * @param max_buckets Número máximo de particiones, contando las de igualdad.
+ *
+ * @return Pivotes ordenados y sin repetir, con sus marcas de igualdad.
+ *
+ * Se toman a * PIVOT_OVERSAMPLING elementos al azar: el archivo se divide en franjas
+ * iguales, se lee un bloque al azar de cada franja y se eligen SAMPLES_PER_BLOCK
+ * elementos al azar de cada bloque, de modo que la muestra cubre todo el archivo. Los
+ * pivotes son los cuantiles a-ésimos de la muestra ordenada; con este sobremuestreo
+ * cada partición queda, con alta probabilidad, cerca de N/a elementos aun si los
+ * datos están sesgados o parcialmente ordenados.
+ *
+ * Los pivotes repetidos se dejan una sola vez. Un pivote que aparece más de una vez
+ * en la muestra es una clave frecuente y recibe una partición de igualdad, que solo
+ * contiene esa clave y por lo tanto ya está ordenada: así una clave con más de M
+ * copias nunca obliga a repartir la misma partición otra vez. Si no caben todas, se
+ * prefieren las claves más frecuentes en la muestra.
+ */
+inline Splitters select_pivots(const std::string& input_file, int64_t N, int a, int max_buckets) {
+    int64_t total_blocks = (N + ELEMENTS_PER_BLOCK - 1) / ELEMENTS_PER_BLOCK;
+    int64_t wanted = std::min<int64_t>(N, (int64_t)a * PIVOT_OVERSAMPLING);
+    int64_t sample_blocks = std::min(total_blocks, std::max<int64_t>(1, wanted / SAMPLES_PER_BLOCK));
+    int64_t per_block = (wanted + sample_blocks - 1) / sample_blocks;
+
+    auto f = scratch_device().open(input_file, OpenMode::READ);
+
+    std::random_device rd;
+    std::mt19937_64 g(rd());
+    ArenaScope scope;
+    int64_t* block = memory_arena.allocate(ELEMENTS_PER_BLOCK);
+    int64_t* sample = memory_arena.allocate(sample_blocks * per_block);
+    int64_t sample_size = 0;
+
+    for (int64_t b = 0; b < sample_blocks; b++) {
+        int64_t first = total_blocks * b / sample_blocks, last = total_blocks * (b + 1) / sample_blocks;
+        int64_t chosen = first + (int64_t)(g() % (uint64_t)std::max<int64_t>(1, last - first));
+        size_t elems = f->read_at(block, BLOCK_SIZE, chosen * BLOCK_SIZE) / ELEMENT_SIZE;
+        read_io++;
+        for (int64_t j = 0; j < per_block && elems > 0; j++) sample[sample_size++] = block[g() % elems];
+    }
+    f.reset();
+
+    std::sort(sample, sample + sample_size);
+    Splitters result;
+    for (int i = 1; i < a && sample_size > 0; i++) {
+        int64_t pivot = sample[sample_size * i / a];
+        if (result.pivots.empty() || result.pivots.back() != pivot) result.pivots.push_back(pivot);
+    }
+
+    // Candidatos a partición de igualdad: pivotes repetidos en la muestra, más frecuentes primero
+    std::vector<std::pair<int64_t, size_t>> frequent;
+    for (size_t i = 0; i < result.pivots.size(); i++) {
+        auto range = std::equal_range(sample, sample + sample_size, result.pivots[i]);
+        int64_t count = range.second - range.first;
+        if (count > 1) frequent.push_back({-count, i});
+    }
+    std::sort(frequent.begin(), frequent.end());
+    result.equal.assign(result.pivots.size(), 0);
+    int64_t room = max_buckets - (int64_t)result.pivots.size() - 1;
+    for (size_t i = 0; i < frequent.size() && (int64_t)i < room; i++) result.equal[frequent[i].second] = 1;
+    return result;
+}
+
+/**
+ * Clasificador de elementos en particiones, al estilo de super scalar sample sort.
+ *
+ * Constructor:
+ *   BucketClassifier(splitters): recibe los pivotes ordenados. Las particiones quedan
+ *   en orden de claves: antes de cada pivote p_i va el rango (p_{i-1}, p_i) y, si p_i
+ *   tiene partición de igualdad, después va la de las claves iguales a p_i; si no,
+ *   p_i queda al comienzo del rango siguiente.
+ *
+ * Métodos:
+ *   classify(data, n, out): escribe en out[i] la partición de data[i].
+ *   num_buckets(): cantidad total de particiones.
+ *   is_equality(b): indica si la partición b es de igualdad.
+ *   equality_key(b): clave de la partición de igualdad b.
+ *
+ * Los pivotes se guardan como un árbol binario de búsqueda implícito en orden de
+ * anchura (la raíz en tree[1], los hijos de i en 2i y 2i+1), completado hasta una
+ * potencia de dos con INT64_MAX. Bajar por el árbol es `i = 2i + (x >= tree[i])`, sin
+ * saltos condicionales, y se bajan varios elementos a la vez para que sus lecturas del
+ * árbol se solapen. Con AVX2 se bajan cuatro elementos por instrucción. El resultado
+ * c (pivotes menores o iguales a x) se traduce a la partición final con tablas, sin
+ * saltos: first[c] + has_equal[c] - (has_equal[c] & (x == equal_key[c])).
+ */
+class BucketClassifier {
+    std::vector<int64_t> tree;
+    int levels = 0;
+    size_t leaves = 1;
+    size_t max_bucket = 0;
+    std::vector<uint16_t> first;
+    std::vector<uint16_t> has_equal;
+    std::vector<int64_t> equal_key;
+    std::vector<char> equality;
+    std::vector<int64_t> keys;
+
+    uint16_t bucket(size_t c, int64_t x) const {
+        return first[c] + has_equal[c] - (has_equal[c] & (uint16_t)(x == equal_key[c]));
+    }
+
+    void build(const std::vector<int64_t>& sorted, size_t node, size_t lo, size_t hi) {
+        if (lo >= hi) return;
+        size_t mid = lo + (hi - lo) / 2;
+        tree[node] = sorted[mid];
+        build(sorted, 2 * node, lo, mid);
+        build(sorted, 2 * node + 1, mid + 1, hi);
+    }
+
+public:
+    explicit BucketClassifier(const Splitters& splitters) : max_bucket(splitters.pivots.size()) {
+        const std::vector<int64_t>& pivots = splitters.pivots;
+        int64_t total = pivots.size() + 1 + std::count(splitters.equal.begin(), splitters.equal.end(), 1);
+        if (total > QUICKSORT_MAX_BUCKETS) {
+            fprintf(stderr, "[ERROR] Demasiadas particiones: %ld (máximo %ld)\n", (long)total, (long)QUICKSORT_MAX_BUCKETS);
+            exit(1);
+        }
+        while (leaves < pivots.size() + 1) {
+            leaves *= 2;
+            levels++;
+        }
+        std::vector<int64_t> padded(pivots);
+        padded.resize(leaves - 1, INT64_MAX);
+        tree.assign(leaves, 0);
+        build(padded, 1, 0, leaves - 1);
+
+        // c = 0 es el rango bajo el primer pivote; c > 0 parte con el pivote c-1
+        first.assign(pivots.size() + 1, 0);
+        has_equal.assign(pivots.size() + 1, 0);
+        equal_key.assign(pivots.size() + 1, 0);
+        uint16_t next = 0;
+        for (size_t c = 0; c <= pivots.size(); c++) {
+            if (c > 0 && splitters.equal[c - 1]) {
+                has_equal[c] = 1;
+                equal_key[c] = pivots[c - 1];
+                equality.push_back(1);
+                keys.push_back(pivots[c - 1]);
+            }
+            first[c] = next;
+            next += has_equal[c];
+            equality.push_back(0);
+            keys.push_back(0);
+            next++;
+        }
+    }
+
+    int num_buckets() const { return equality.size(); }
+    bool is_equality(int b) const { return equality[b]; }
+    int64_t equality_key(int b) const { return keys[b]; }
+
+    void classify(const int64_t* data, size_t n, uint16_t* out) const {
+        const int64_t* t = tree.data();
+        size_t j = 0;
+#ifdef __AVX2__
+        const __m256i one = _mm256_set1_epi64x(1);
+        for (; j + 4 <= n; j += 4) {
+            __m256i x = _mm256_loadu_si256((const __m256i*)(data + j));
+            __m256i idx = one;
+            for (int l = 0; l < levels; l++) {
+                __m256i node = _mm256_i64gather_epi64((const long long*)t, idx, 8);
+                // x >= node equivale a no(node > x): se suma 1 y se resta la máscara
+                __m256i greater = _mm256_cmpgt_epi64(node, x);
+                idx = _mm256_add_epi64(_mm256_add_epi64(_mm256_slli_epi64(idx, 1), one), greater);
+            }
+            alignas(32) int64_t res[4];
+            _mm256_store_si256((__m256i*)res, idx);
+            for (int u = 0; u < 4; u++) out[j + u] = bucket(std::min<size_t>(res[u] - leaves, max_bucket), data[j + u]);
+        }
+#endif
+        const size_t U = 8;
+        for (; j + U <= n; j += U) {
+            size_t idx[U];
+            for (size_t u = 0; u < U; u++) idx[u] = 1;
+            for (int l = 0; l < levels; l++) {
+                for (size_t u = 0; u < U; u++) idx[u] = 2 * idx[u] + (data[j + u] >= t[idx[u]]);
+            }
+            for (size_t u = 0; u < U; u++) out[j + u] = bucket(std::min(idx[u] - leaves, max_bucket), data[j + u]);
+        }
+        for (; j < n; j++) {
+            size_t idx = 1;
+            for (int l = 0; l < levels; l++) idx = 2 * idx + (data[j] >= t[idx]);
+            out[j] = bucket(std::min(idx - leaves, max_bucket), data[j]);
+        }
+    }
+};
+
+/**
+ * Ordena un archivo de enteros de 64 bits y escribe el resultado en un tramo de un
+ * archivo de salida ya abierto (una llamada de la recursión de quicksort_external).
+ *
+ * Parámetros:
+ * @param input_file Nombre del archivo de entrada que contiene los enteros a ordenar.
+ * @param out        Archivo de salida, abierto para escritura.
+ * @param out_offset Posición (en elementos) del archivo de salida donde empieza el resultado.
+ * @param a          Número de pivotes + 1 que se utilizarán en cada nivel de recursión.
+ * @param N          Número total de elementos presentes en el archivo de entrada.
+ * @param M          Número máximo de elementos que se pueden cargar en memoria principal.
+ * @param depth      Profundidad de la recursión, para las métricas de cada fase.
+ *
+ * La distribución cuenta los elementos de cada partición, así que la posición final de
+ * cada una en la salida es la suma de los tamaños de las anteriores: cada partición se
+ * ordena directamente en su tramo con `write_at` y no hace falta concatenarlas después. Las
+ * particiones de igualdad no se escriben a disco: basta con repetir su clave en su tramo.
+ */
+inline void quicksort_into(const std::string& input_file, BlockFile* out, int64_t out_offset, int a, int64_t N, int64_t M,
+                           int depth = 0) {
+    ArenaScope scope;
+
+    if (N <= M) {
+        PhaseTimer phase("caso_base", depth);
+        // Cargar, ordenar en memoria y escribir en su tramo; si la salida se puede
+        // proyectar en memoria, se carga y ordena directamente en su tramo proyectado
+        std::unique_ptr<MappedRange> mapping = out->map(out_offset * ELEMENT_SIZE, N * ELEMENT_SIZE);
+        int64_t* buf = mapping ? (int64_t*)mapping->data() : memory_arena.allocate(N);
+        scratch_device().open(input_file, OpenMode::READ)->read(buf, N * ELEMENT_SIZE);
+
+        bool use_scratch = memory_sort_uses_scratch(N) && memory_arena.available() >= (size_t)N;
+        memory_sort(buf, N, use_scratch ? memory_arena.allocate(N) : nullptr);
+
+        if (mapping) mapping->sync();
+        else out->write_at(buf, N * ELEMENT_SIZE, out_offset * ELEMENT_SIZE);
+        read_io += (N + ELEMENTS_PER_BLOCK - 1) / ELEMENTS_PER_BLOCK;
+        write_io += (N + ELEMENTS_PER_BLOCK - 1) / ELEMENTS_PER_BLOCK;
+        return;
+    }
+
+    size_t scope_mark = memory_arena.mark();
+
+    // La distribución usa dos bloques de lectura y reparte el resto de la memoria en
+    // bloques de partición
+    int64_t pool_estimate = (int64_t)memory_arena.available() / ELEMENTS_PER_BLOCK - 2;
+    int max_buckets = quicksort_max_buckets(pool_estimate);
+    if (max_buckets < 3) {
+        fprintf(stderr, "[ERROR] Memoria insuficiente para QuickSort: se necesitan al menos %ld bloques\n",
+                (long)QUICKSORT_MIN_BLOCKS);
+        exit(1);
+    }
+    a = std::max(2, std::min(a, max_buckets));
+
+    PhaseTimer sampling("muestreo_pivotes", depth);
+    BucketClassifier classifier(select_pivots(input_file, N, a, max_buckets));
+    int buckets = classifier.num_buckets();
+    sampling.stop();
+
+    PhaseTimer distribution("distribucion", depth);
+
+    // Preparar archivos de partición (las de igualdad solo se cuentan), en discos
+    // temporales distintos del que tiene la entrada, si hay varios
+    std::vector<std::string> part_files;
+    std::vector<std::unique_ptr<BlockFile>> parts(buckets);
+    for (int i = 0; i < buckets; i++) {
+        std::string part_name = input_file + "_part_" + std::to_string(i);
+        part_files.push_back(part_name);
+        if (!classifier.is_equality(i)) parts[i] = create_scratch(part_name, {input_file});
+    }
+
+    // Leer y repartir los datos según los pivotes. El motor de E/S lee por adelantado el
+    // siguiente bloque de entrada y escribe las particiones mientras se reparte el bloque
+    // actual. Los bloques de partición salen de un pool común que ocupa el resto de M:
+    // cada partición llena un bloque y, al completarlo, lo encola y toma otro libre.
+    // Cuando quedan pocos bloques libres se encarga en un solo lote la escritura de las
+    // particiones con más bloques en cola (al menos la mitad que la mayor), cada una en
+    // una escritura secuencial de varios tramos; sus bloques vuelven al pool a medida que
+    // esas escrituras terminan.
+    auto f = scratch_device().open(input_file, OpenMode::READ);
+    BlockFile* in = f.get();
+    IOEngine io;
+    int64_t* read_bufs[2] = {memory_arena.allocate(ELEMENTS_PER_BLOCK), memory_arena.allocate(ELEMENTS_PER_BLOCK)};
+    int read_idx = 0;
+    int64_t read_pos = 0;
+
+    size_t pool_blocks = memory_arena.available() / ELEMENTS_PER_BLOCK;
+    if (pool_blocks < (size_t)buckets + 1) {
+        fprintf(stderr, "[ERROR] Memoria insuficiente para %d particiones: quedan %zu bloques\n", buckets, pool_blocks);
+        exit(1);
+    }
+    int64_t* pool = memory_arena.allocate(pool_blocks * ELEMENTS_PER_BLOCK);
+    std::vector<int64_t*> free_blocks;
+    for (size_t b = 0; b < pool_blocks; b++) free_blocks.push_back(pool + b * ELEMENTS_PER_BLOCK);
+    size_t low_water = pool_blocks / 4;
+
+    std::vector<int64_t*> part_buffers(buckets);
+    std::vector<size_t> part_sizes(buckets, 0);
+    std::vector<int64_t> part_counts(buckets, 0);
+    std::vector<int64_t> part_bytes(buckets, 0);
+    std::vector<std::vector<iovec>> pending(buckets);
+    std::deque<std::pair<uint64_t, std::vector<iovec>>> in_flight;
+
+    auto prefetch = [&](int idx) {
+        uint64_t ticket = io.read(in, read_bufs[idx], BLOCK_SIZE, read_pos);
+        read_pos += BLOCK_SIZE;
+        io.submit();
+        return ticket;
+    };
+
+    // Encarga la escritura de todos los bloques en cola de la partición k
+    auto write_pending = [&](int k) {
+        if (pending[k].empty()) return;
+        std::vector<iovec> batch;
+        batch.swap(pending[k]);
+        write_io += batch.size();
+        uint64_t ticket = io.write_gather(parts[k].get(), batch.data(), batch.size(), part_bytes[k]);
+        for (const iovec& v : batch) part_bytes[k] += v.iov_len;
+        in_flight.emplace_back(ticket, std::move(batch));
+    };
+
+    // Recupera los bloques de la escritura más antigua en curso
+    auto reclaim = [&] {
+        io.wait(in_flight.front().first);
+        for (const iovec& v : in_flight.front().second) free_blocks.push_back((int64_t*)v.iov_base);
+        in_flight.pop_front();
+    };
+
+    // Encarga en un lote las particiones con al menos la mitad de bloques en cola que la mayor
+    auto write_batch = [&] {
+        size_t largest = 0;
+        for (int i = 0; i < buckets; i++) largest = std::max(largest, pending[i].size());
+        for (int i = 0; i < buckets; i++) {
+            if (!pending[i].empty() && 2 * pending[i].size() >= largest) write_pending(i);
+        }
+        io.submit();
+    };
+
+    auto take_block = [&] {
+        while (free_blocks.empty()) {
+            if (in_flight.empty()) write_batch();
+            else reclaim();
+        }
+        int64_t* block = free_blocks.back();
+        free_blocks.pop_back();
+        return block;
+    };
+
+    // Cierra el bloque actual de la partición k
+    auto flush_part = [&](int k) {
+        size_t n = part_sizes[k];
+        part_sizes[k] = 0;
+        part_counts[k] += n;
+        if (!parts[k]) return;
+        pending[k].push_back({part_buffers[k], n * ELEMENT_SIZE});
+        part_buffers[k] = take_block();
+        while (!in_flight.empty() && io.ready(in_flight.front().first)) reclaim();
+        if (free_blocks.size() < low_water && in_flight.empty()) write_batch();
+    };
+
+    for (int i = 0; i < buckets; i++) part_buffers[i] = take_block();
+    std::vector<uint16_t> bucket_of(ELEMENTS_PER_BLOCK);
+
+    uint64_t read_ticket = prefetch(read_idx);
+    while (true) {
+        size_t elems = io.wait(read_ticket) / ELEMENT_SIZE;
+        if (elems == 0) break;
+        read_io++;
+        const int64_t* read_buf = read_bufs[read_idx];
+        read_idx ^= 1;
+        read_ticket = prefetch(read_idx);
+
+        classifier.classify(read_buf, elems, bucket_of.data());
+        for (size_t j = 0; j < elems; j++) {
+            int k = bucket_of[j];
+            part_buffers[k][part_sizes[k]++] = read_buf[j];
+
+            if (part_sizes[k] == ELEMENTS_PER_BLOCK) flush_part(k);
+        }
+    }
+
+    for (int i = 0; i < buckets; i++) {
+        if (part_sizes[i] > 0) flush_part(i);
+        write_pending(i);
+    }
+    io.submit();
+    while (!in_flight.empty()) reclaim();
+    f.reset();
+
+    std::vector<char> has_file(buckets);
+    for (int i = 0; i < buckets; i++) has_file[i] = parts[i] != nullptr;
+    parts.clear();
+
+    // Tramo de cada partición en la salida
+    std::vector<int64_t> part_offsets(buckets + 1, out_offset);
+    for (int i = 0; i < buckets; i++) part_offsets[i + 1] = part_offsets[i] + part_counts[i];
+
+    // Las particiones de igualdad se escriben repitiendo su clave
+    int64_t* fill_buf = read_bufs[0];
+    for (int i = 0; i < buckets; i++) {
+        if (!classifier.is_equality(i) || part_counts[i] == 0) continue;
+        std::fill(fill_buf, fill_buf + ELEMENTS_PER_BLOCK, classifier.equality_key(i));
+        for (int64_t pos = part_offsets[i]; pos < part_offsets[i + 1]; pos += ELEMENTS_PER_BLOCK) {
+            int64_t n = std::min(ELEMENTS_PER_BLOCK, part_offsets[i + 1] - pos);
+            out->write_at(fill_buf, n * ELEMENT_SIZE, pos * ELEMENT_SIZE);
+            write_io++;
+        }
+    }
+
+    // Los buffers de la distribución se devuelven antes de la recursión
+    memory_arena.release(scope_mark);
+    distribution.stop();
+
+    // Ordenar cada partición en su tramo
+    for (int i = 0; i < buckets; i++) {
+        if (!has_file[i]) continue;
+        if (part_counts[i] > 0) quicksort_into(part_files[i], out, part_offsets[i], a, part_counts[i], M, depth + 1);
+        scratch_device().remove(part_files[i]);
+    }
+}
+
+/**
+ * Ordena un archivo binario que contiene enteros de 64 bits usando una versión de Quicksort multi-pivote en memoria externa.
+ *
+ * Parámetros:
+ * @param input_file  Nombre del archivo de entrada que contiene los enteros a ordenar.
+ * @param output_file Nombre del archivo de salida donde se guardarán los enteros ya ordenados.
+ * @param a           Número de pivotes + 1 que se utilizarán en cada nivel de recursión.
+ * @param N           Número total de elementos presentes en el archivo de entrada.
+ * @param M           Número máximo de elementos que se pueden cargar en memoria principal.
+ *
+ * Todos los buffers de datos salen de `memory_arena`, que se reserva una sola vez con M
+ * elementos; cada fase devuelve su memoria antes de la recursión. El archivo de salida
+ * se preasigna con N elementos y cada partición se escribe en su tramo. Las particiones
+ * de todos los niveles viven en un único archivo de espacio temporal junto a la entrada
+ * (`ScratchSpace`), que reutiliza el espacio de las que ya se ordenaron.
+ *
+ * Los contadores read_io / write_io se reinician al comenzar y se suman una sola vez a
+ * total_read_io / total_write_io al terminar, sin importar la profundidad de la
+ * recursión. Cada fase de cada nivel se registra en `metrics`.
+ */
+inline void quicksort_external(const std::string& input_file, const std::string& output_file, int a, int64_t N, int64_t M) {
+    if (N > M && M < QUICKSORT_MIN_BLOCKS * ELEMENTS_PER_BLOCK) {
+        fprintf(stderr, "[ERROR] Memoria insuficiente para QuickSort: se necesitan al menos %ld bloques\n",
+                (long)QUICKSORT_MIN_BLOCKS);
+        exit(1);
+    }
+    memory_arena.init(M);
+    read_io = 0;
+    write_io = 0;
+
+    auto out = block_device().open(output_file, OpenMode::CREATE);
+    out->truncate(N * ELEMENT_SIZE);
+    ScratchScope scratch(input_file);
+
+    quicksort_into(input_file, out.get(), 0, a, N, M);
+    out.reset();
+
+    total_read_io += read_io;
+    total_write_io += write_io;
+}
+
+/**
+ * Elige la cantidad de particiones que minimiza el tiempo estimado de quicksort_external
+ * en el dispositivo descrito por `profile`.
+ *
+ * @param N       Número total de elementos.
+ * @param M       Número máximo de elementos que se pueden cargar en memoria principal.
+ * @param profile Perfil medido del directorio de archivos temporales.
+ *
+ * @return Aridad elegida.
+ *
+ * Cada nivel de recursión lee y escribe todos los datos y cuesta log2(a) comparaciones
+ * por elemento. Las lecturas son secuenciales, pero cada escritura del pool de bloques
+ * es un acceso aleatorio que lleva en promedio unos 3/4 del pool repartidos entre las a
+ * particiones: más particiones hacen menos niveles, pero escrituras más chicas.
+ */
+inline int tune_quicksort_arity(int64_t N, int64_t M, const DeviceProfile& profile) {
+    int max_buckets = std::max(3, quicksort_max_buckets(M / ELEMENTS_PER_BLOCK - 2));
+    double pool_blocks = M / ELEMENTS_PER_BLOCK - 2;
+    double data_blocks = (double)(N + ELEMENTS_PER_BLOCK - 1) / ELEMENTS_PER_BLOCK;
+    int best_a = 2;
+    double best_seconds = -1;
+    for (int a = 2; a <= max_buckets; a++) {
+        int levels = 0;
+        for (int64_t n = N; n > M; n = (n + a - 1) / a) levels++;
+        double seeks = data_blocks / std::max(1.0, 0.75 * pool_blocks / a);
+        double seconds = levels * profile.seconds(2 * data_blocks * BLOCK_SIZE, seeks, (double)N * std::log2(a));
+        if (best_seconds < 0 || seconds < best_seconds) {
+            best_a = a;
+            best_seconds = seconds;
+        }
+    }
+    return best_a;
+}
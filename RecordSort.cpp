@@ -0,0 +1,93 @@
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <chrono>
+#include <algorithm>
+
+#include "record_sort.hpp"
+
+using namespace std::chrono;
+
+/**
+ * Ordena con `record_sort_external` registros del tipo R y retorna el tiempo en ms.
+ */
+template <typename R, typename KeyOf>
+long long run_record_sort(const std::string& input_file, const std::string& output_file, int64_t N_bytes, int64_t M_bytes,
+                          int64_t a, RecordSortMode mode) {
+    auto start = high_resolution_clock::now();
+    record_sort_external<R, KeyOf>(input_file, output_file, N_bytes / (int64_t)sizeof(R), M_bytes, a, mode);
+    auto end = high_resolution_clock::now();
+    return duration_cast<milliseconds>(end - start).count();
+}
+
+/**
+ * Función principal del programa.
+ *
+ * @param argc Número de argumentos (entre 6 y 9).
+ * @param argv Argumentos:
+ *    [1] archivo de entrada,
+ *    [2] archivo de salida,
+ *    [3] N_bytes: tamaño total del archivo de entrada en bytes,
+ *    [4] M_bytes: memoria disponible en bytes,
+ *    [5] tipo de registro: "int64" (enteros de 8 bytes, mismo camino que MergeSort),
+ *        "keyrow" (clave int64 y número de fila, 16 bytes) o "gensort" (registros de
+ *        100 bytes con clave de 10 bytes),
+ *    [6] (opcional) aridad máxima de cada mezcla (por defecto 16),
+ *    [7] (opcional) ordenamiento en memoria: "auto" (por defecto), "records" (registros
+ *        completos) o "pointer" (pares clave-índice), ver record_sort.hpp,
+ *    [8] (opcional) almacenamiento: "stdio" (por defecto), "direct", "pread", "mmap" o un
+ *        disco simulado "sim:..." (ver block_device.hpp).
+ *
+ * @return 0 si termina exitosamente, 1 en caso de error.
+ */
+int main(int argc, char* argv[]) {
+    if (argc < 6 || argc > 9) {
+        fprintf(stderr, "Uso: %s <archivo_entrada> <archivo_salida> <N_bytes> <M_bytes> <int64|keyrow|gensort> [aridad] [auto|records|pointer] [stdio|direct|sim:...]\n", argv[0]);
+        return 1;
+    }
+
+    std::string input_file = argv[1];
+    std::string output_file = argv[2];
+    int64_t N_bytes = atoll(argv[3]);
+    int64_t M_bytes = atoll(argv[4]);
+    std::string type = argv[5];
+    int64_t a = argc >= 7 ? std::max(2LL, atoll(argv[6])) : 16;
+    RecordSortMode mode = RecordSortMode::AUTO;
+    if (argc >= 8) {
+        std::string m = argv[7];
+        if (m == "records") {
+            mode = RecordSortMode::RECORDS;
+        } else if (m == "pointer") {
+            mode = RecordSortMode::KEY_POINTER;
+        } else if (m != "auto") {
+            fprintf(stderr, "[ERROR] Ordenamiento en memoria desconocido: %s\n", argv[7]);
+            return 1;
+        }
+    }
+    if (argc >= 9 && !parse_block_device(argv[8])) {
+        fprintf(stderr, "[ERROR] Almacenamiento desconocido: %s\n", argv[8]);
+        return 1;
+    }
+
+    long long ms;
+    if (type == "int64") {
+        ms = run_record_sort<int64_t, Int64Key>(input_file, output_file, N_bytes, M_bytes, a, mode);
+    } else if (type == "keyrow") {
+        ms = run_record_sort<KeyRowRecord, KeyRowKey>(input_file, output_file, N_bytes, M_bytes, a, mode);
+    } else if (type == "gensort") {
+        ms = run_record_sort<GensortRecord, GensortKey>(input_file, output_file, N_bytes, M_bytes, a, mode);
+    } else {
+        fprintf(stderr, "[ERROR] Tipo de registro desconocido: %s\n", argv[5]);
+        return 1;
+    }
+    block_device().persist(output_file);
+
+    printf("Tiempo total: %lld ms\n", ms);
+    printf("I/Os totales: %ld (lecturas: %ld, escrituras: %ld)\n",
+        total_read_io + total_write_io, total_read_io, total_write_io);
+    printf("Runs: %ld, pasadas de mezcla: %ld\n", total_runs, total_merge_passes);
+    print_block_device_summary();
+
+    return 0;
+}
@@ -0,0 +1,278 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <algorithm>
+
+#include "sort_common.hpp"
+#include "metrics.hpp"
+#include "block_device.hpp"
+#include "memory_arena.hpp"
+#include "MergeSort.hpp"
+#include "QuickSort.hpp"
+
+// Ventanas que lee el sondeo, repartidas a lo largo de la entrada
+const int64_t PROBE_WINDOWS = 64;
+
+// Bloques leídos por ventana del sondeo
+const int64_t PROBE_WINDOW_BLOCKS = 1;
+
+// Fracción de pares de ventanas fuera de orden bajo la cual la entrada se considera casi
+// ordenada (el desorden es local y la selección por reemplazo forma runs muy largos)
+const double NEARLY_SORTED_INVERSIONS = 0.05;
+
+// Fracción de claves repetidas en la muestra desde la cual conviene QuickSort, cuyas
+// particiones de igualdad no se escriben a disco
+const double DUPLICATE_HEAVY = 0.5;
+
+// Bloques que lee de una vez la detección de runs naturales
+const int64_t NATURAL_SCAN_BLOCKS = 64;
+
+// Estrategias que puede elegir `adaptive_sort`
+enum class SortStrategy {
+    IN_MEMORY,     // La entrada cabe en M: un solo ordenamiento en memoria
+    NATURAL,       // Mezcla de los runs que ya tiene la entrada, sin formar runs
+    MERGESORT,     // mergesort_external con selección por reemplazo
+    QUICKSORT      // quicksort_external
+};
+
+inline const char* strategy_name(SortStrategy s) {
+    switch (s) {
+        case SortStrategy::IN_MEMORY: return "memoria";
+        case SortStrategy::NATURAL: return "mezcla_natural";
+        case SortStrategy::MERGESORT: return "mergesort";
+        case SortStrategy::QUICKSORT: return "quicksort";
+    }
+    return "?";
+}
+
+// Resultado del sondeo de una entrada
+struct Presortedness {
+    int64_t sampled = 0;      // Elementos leídos
+    int64_t adjacent = 0;     // Pares consecutivos dentro de una ventana
+    int64_t descents = 0;     // Pares consecutivos en orden decreciente
+    int64_t inversions = 0;   // Pares de ventanas cuyos primeros elementos están invertidos
+    int64_t pairs = 0;        // Pares de ventanas comparados
+    int64_t duplicates = 0;   // Elementos de la muestra iguales a otro de la muestra
+
+    // Runs ascendentes que se esperan en N elementos, según los descensos de la muestra
+    int64_t estimated_runs(int64_t N) const {
+        if (adjacent <= 0) return 1;
+        return 1 + (int64_t)((double)descents / adjacent * (N - 1));
+    }
+
+    double inversion_rate() const { return pairs > 0 ? (double)inversions / pairs : 0.0; }
+
+    double duplicate_rate() const { return sampled > 0 ? (double)duplicates / sampled : 0.0; }
+};
+
+/**
+ * Estima qué tan ordenada está una entrada leyendo unas pocas ventanas.
+ *
+ * @param input_file Archivo de entrada.
+ * @param N Número total de elementos.
+ *
+ * @return Descensos dentro de las ventanas (estiman la cantidad de runs ascendentes),
+ *         inversiones entre los primeros elementos de las ventanas (estiman el desorden
+ *         global) y claves repetidas en la muestra.
+ *
+ * Lee PROBE_WINDOWS ventanas de PROBE_WINDOW_BLOCKS bloques equiespaciadas (la primera al
+ * comienzo y la última al final de la entrada), con lecturas posicionales: cuesta unas
+ * 64 lecturas aleatorias, sin importar N.
+ */
+inline Presortedness probe_presortedness(const std::string& input_file, int64_t N) {
+    Presortedness p;
+    if (N <= 0) return p;
+    auto f = block_device().open(input_file, OpenMode::READ);
+
+    ArenaScope scope;
+    const int64_t window = std::min(N, PROBE_WINDOW_BLOCKS * ELEMENTS_PER_BLOCK);
+    int64_t windows = std::min(PROBE_WINDOWS, N / window);
+    int64_t* buf = memory_arena.allocate(window);
+    std::vector<int64_t> firsts, sample;
+
+    for (int64_t w = 0; w < windows; w++) {
+        int64_t start = windows == 1 ? 0 : (N - window) * w / (windows - 1);
+        int64_t n = f->read_at(buf, window * ELEMENT_SIZE, start * ELEMENT_SIZE) / ELEMENT_SIZE;
+        read_io += (n + ELEMENTS_PER_BLOCK - 1) / ELEMENTS_PER_BLOCK;
+        if (n == 0) continue;
+        p.adjacent += n - 1;
+        for (int64_t i = 1; i < n; i++) p.descents += buf[i] < buf[i - 1];
+        firsts.push_back(buf[0]);
+        sample.insert(sample.end(), buf, buf + n);
+    }
+
+    for (size_t i = 0; i < firsts.size(); i++) {
+        for (size_t j = i + 1; j < firsts.size(); j++) p.inversions += firsts[i] > firsts[j];
+    }
+    p.pairs = firsts.size() * (firsts.size() - (firsts.empty() ? 0 : 1)) / 2;
+
+    p.sampled = sample.size();
+    std::sort(sample.begin(), sample.end());
+    for (size_t i = 1; i < sample.size(); i++) p.duplicates += sample[i] == sample[i - 1];
+    return p;
+}
+
+/**
+ * Elige cómo ordenar una entrada según su tamaño y su sondeo.
+ *
+ * @param probe Resultado de `probe_presortedness`.
+ * @param N Número total de elementos.
+ * @param M Cantidad máxima de elementos que caben en memoria.
+ *
+ * @return IN_MEMORY si cabe en M; NATURAL si los runs ascendentes esperados caben en una
+ *         sola mezcla; MERGESORT si el desorden es local (pocas inversiones entre
+ *         ventanas: la selección por reemplazo forma runs muy largos); QUICKSORT si la
+ *         muestra tiene muchas claves repetidas y M alcanza para su distribución
+ *         (QUICKSORT_MIN_BLOCKS); MERGESORT en otro caso.
+ */
+inline SortStrategy choose_strategy(const Presortedness& probe, int64_t N, int64_t M) {
+    if (N <= M) return SortStrategy::IN_MEMORY;
+    if (probe.estimated_runs(N) <= max_merge_arity(M)) return SortStrategy::NATURAL;
+    if (probe.inversion_rate() < NEARLY_SORTED_INVERSIONS) return SortStrategy::MERGESORT;
+    if (probe.duplicate_rate() >= DUPLICATE_HEAVY && M >= QUICKSORT_MIN_BLOCKS * ELEMENTS_PER_BLOCK) {
+        return SortStrategy::QUICKSORT;
+    }
+    return SortStrategy::MERGESORT;
+}
+
+/**
+ * Busca los runs ascendentes que ya tiene la entrada, leyéndola una vez.
+ *
+ * @param input_file Archivo de entrada.
+ * @param N Número total de elementos.
+ * @param max_runs Cantidad de runs desde la cual se deja de buscar.
+ *
+ * @return Posición donde empieza cada run, o una lista de más de `max_runs` posiciones
+ *         si la entrada tiene más runs (se corta la lectura ahí).
+ */
+inline std::vector<int64_t> find_natural_runs(const std::string& input_file, int64_t N, int64_t max_runs) {
+    std::vector<int64_t> starts;
+    if (N <= 0) return starts;
+    starts.push_back(0);
+    auto f = block_device().open(input_file, OpenMode::READ);
+
+    ArenaScope scope;
+    int64_t chunk = std::min<int64_t>(NATURAL_SCAN_BLOCKS * ELEMENTS_PER_BLOCK, memory_arena.available());
+    chunk = std::max<int64_t>(chunk / ELEMENTS_PER_BLOCK, 1) * ELEMENTS_PER_BLOCK;
+    int64_t* buf = memory_arena.allocate(chunk);
+    int64_t last = 0;
+    for (int64_t pos = 0; pos < N; pos += chunk) {
+        int64_t n = std::min(chunk, N - pos);
+        f->read(buf, n * ELEMENT_SIZE);
+        read_io += (n + ELEMENTS_PER_BLOCK - 1) / ELEMENTS_PER_BLOCK;
+        for (int64_t i = 0; i < n; i++) {
+            if (pos + i > 0 && buf[i] < last) {
+                starts.push_back(pos + i);
+                if ((int64_t)starts.size() > max_runs) return starts;
+            }
+            last = buf[i];
+        }
+    }
+    return starts;
+}
+
+/**
+ * Ordena una entrada mezclando los runs ascendentes que ya tiene (mezcla natural).
+ *
+ * @param input_file Archivo de entrada.
+ * @param output_file Archivo de salida.
+ * @param N Número total de elementos.
+ * @param M Cantidad máxima de elementos que caben en memoria.
+ *
+ * @return false si la entrada tiene más runs de los que caben en una mezcla; entonces no
+ *         escribe nada y hay que ordenarla de otra forma.
+ *
+ * Una pasada de lectura ubica los runs y una mezcla de `merge_ranges` los combina leyendo
+ * cada uno directamente de su tramo de la entrada, sin escribir runs temporales. Con una
+ * entrada ya ordenada hay un solo run y la mezcla es una copia: en total una lectura de
+ * detección más una lectura y una escritura.
+ */
+inline bool natural_merge(const std::string& input_file, const std::string& output_file, int64_t N, int64_t M) {
+    std::vector<int64_t> starts;
+    {
+        PhaseTimer phase("deteccion_runs");
+        starts = find_natural_runs(input_file, N, max_merge_arity(M));
+    }
+    if ((int64_t)starts.size() > max_merge_arity(M)) return false;
+
+    PhaseTimer phase("mezcla_natural");
+    size_t k = starts.size();
+    std::vector<int64_t> begin = starts, end(k);
+    for (size_t i = 0; i < k; i++) end[i] = i + 1 < k ? starts[i + 1] : N;
+    total_runs = k;
+    total_merge_passes = 1;
+
+    auto out = block_device().open(output_file, OpenMode::CREATE);
+    ArenaScope scope;
+    int64_t* memory = memory_arena.allocate(merge_memory(k));
+    IOCount c = merge_ranges(std::vector<std::string>(k, input_file), begin, end, out.get(), 0, memory);
+    read_io += c.reads;
+    write_io += c.writes;
+    return true;
+}
+
+/**
+ * Ordena una entrada eligiendo el algoritmo según su tamaño y qué tan ordenada está.
+ *
+ * @param input_file Archivo de entrada.
+ * @param output_file Archivo de salida.
+ * @param N Número total de elementos.
+ * @param M Cantidad máxima de elementos que caben en memoria.
+ * @param a Aridad de MergeSort o cantidad de particiones de QuickSort; 0 para ajustarla
+ *          con el perfil del dispositivo (ver autotune.hpp) según el algoritmo elegido.
+ *
+ * @return Estrategia usada.
+ *
+ * Si la entrada no cabe en memoria, la sondea (`probe_presortedness`) y elige con
+ * `choose_strategy`. Si la mezcla natural encuentra más runs de los esperados, la lectura
+ * de detección se pierde y se sigue con MergeSort. Las I/Os del sondeo y de la detección
+ * se suman a total_read_io como las de cualquier fase.
+ */
+inline SortStrategy adaptive_sort(const std::string& input_file, const std::string& output_file, int64_t N, int64_t M,
+                                  int64_t a = 0) {
+    memory_arena.init(M);
+    fit_merge_buffers(M);
+    read_io = 0;
+    write_io = 0;
+
+    SortStrategy strategy = SortStrategy::IN_MEMORY;
+    if (N > M) {
+        Presortedness probe;
+        {
+            PhaseTimer phase("sondeo");
+            probe = probe_presortedness(input_file, N);
+        }
+        strategy = choose_strategy(probe, N, M);
+    }
+
+    if (strategy == SortStrategy::NATURAL && !natural_merge(input_file, output_file, N, M)) {
+        strategy = SortStrategy::MERGESORT;
+    }
+    if (strategy == SortStrategy::NATURAL) {
+        total_read_io += read_io;
+        total_write_io += write_io;
+        return strategy;
+    }
+
+    // mergesort_external y quicksort_external reinician los contadores: se les suma lo ya hecho
+    long probe_reads = read_io, probe_writes = write_io;
+    if (strategy == SortStrategy::QUICKSORT) {
+        if (a == 0) a = tune_quicksort_arity(N, M, device_profile_for(input_file));
+        quicksort_external(input_file, output_file, a, N, M);
+    } else {
+        if (a == 0 && N > M) {
+            MergeTuning tuning = tune_mergesort(N, M, RunFormation::REPLACEMENT_SELECTION, device_profile_for(input_file));
+            a = tuning.arity;
+            merge_buffer_blocks = tuning.buffer_blocks;
+        }
+        mergesort_external(input_file, output_file, N, M, std::max<int64_t>(a, 2));
+    }
+    read_io += probe_reads;
+    write_io += probe_writes;
+    total_read_io += probe_reads;
+    total_write_io += probe_writes;
+    return strategy;
+}
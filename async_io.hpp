@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+
+#include "metrics.hpp"
+
+/**
+ * Hilo de E/S en segundo plano.
+ *
+ * Ejecuta, en orden de llegada, las lecturas y escrituras que se le encargan, de modo
+ * que el hilo que ordena o mezcla puede seguir trabajando mientras el disco atiende la
+ * operación. Cada operación encargada recibe un ticket creciente; como se ejecutan en
+ * orden, `wait(ticket)` garantiza que esa operación y todas las anteriores terminaron.
+ *
+ * Métodos:
+ *   submit(task): encarga una operación y retorna su ticket.
+ *   done(ticket): indica, sin bloquear, si la operación con ese ticket terminó.
+ *   wait(ticket): bloquea hasta que la operación con ese ticket terminó (0 no espera);
+ *     el tiempo bloqueado se registra en `metrics` como espera de E/S.
+ *   drain(): bloquea hasta que terminen todas las operaciones encargadas.
+ */
+class IOThread {
+    std::mutex mtx;
+    std::condition_variable cv_task, cv_done;
+    std::deque<std::function<void()>> tasks;
+    uint64_t submitted = 0, completed = 0;
+    bool stopping = false;
+    std::thread worker;
+
+    void run() {
+        io_worker_thread = true;
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                cv_task.wait(lock, [&] { return stopping || !tasks.empty(); });
+                if (tasks.empty()) return;
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                completed++;
+            }
+            cv_done.notify_all();
+        }
+    }
+
+public:
+    IOThread() : worker(&IOThread::run, this) {}
+
+    ~IOThread() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stopping = true;
+        }
+        cv_task.notify_one();
+        worker.join();
+    }
+
+    IOThread(const IOThread&) = delete;
+    IOThread& operator=(const IOThread&) = delete;
+
+    uint64_t submit(std::function<void()> task) {
+        uint64_t ticket;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            tasks.push_back(std::move(task));
+            ticket = ++submitted;
+        }
+        cv_task.notify_one();
+        return ticket;
+    }
+
+    bool done(uint64_t ticket) {
+        std::lock_guard<std::mutex> lock(mtx);
+        return completed >= ticket;
+    }
+
+    void wait(uint64_t ticket) {
+        std::unique_lock<std::mutex> lock(mtx);
+        if (completed >= ticket) return;
+        auto start = std::chrono::steady_clock::now();
+        cv_done.wait(lock, [&] { return completed >= ticket; });
+        lock.unlock();
+        metrics.record_wait(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    void drain() {
+        uint64_t last;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            last = submitted;
+        }
+        wait(last);
+    }
+};
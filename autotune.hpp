@@ -0,0 +1,166 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cmath>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "scratch_space.hpp"
+
+/**
+ * Parámetros medidos de un directorio de archivos temporales: con ellos se estima el
+ * tiempo de una fase de E/S como  accesos * seek_ms + bytes / ancho de banda, y el de
+ * una fase de CPU como  comparaciones * cpu_ns.
+ */
+struct DeviceProfile {
+    double seek_ms = 0;         // Costo de un acceso aleatorio, sin contar la transferencia
+    double bandwidth_mb_s = 0;  // Ancho de banda de lectura secuencial
+    double cpu_ns = 0;          // Costo de una comparación al ordenar o mezclar
+
+    /**
+     * Estima el tiempo (en segundos) de una fase que transfiere `bytes`, hace `seeks`
+     * accesos aleatorios y `comparisons` comparaciones.
+     */
+    double seconds(double bytes, double seeks, double comparisons) const {
+        return bytes / (bandwidth_mb_s * 1024 * 1024) + seeks * seek_ms / 1000 + comparisons * cpu_ns / 1e9;
+    }
+};
+
+// Tamaño del archivo de muestra con que se mide un directorio
+const int64_t PROFILE_SAMPLE_BYTES = 16 * 1024 * 1024;
+
+// Lecturas aleatorias de un bloque con que se mide el costo de un acceso
+const int PROFILE_RANDOM_READS = 256;
+
+/**
+ * Retorna el directorio donde un ordenamiento de `file` escribe sus archivos temporales:
+ * el primero de `scratch_dirs` si se eligieron directorios o, si no, el de `file` ("."
+ * si el nombre no tiene directorio).
+ */
+inline std::string scratch_dir_of(const std::string& file) {
+    if (!scratch_dirs.empty()) return scratch_dirs.front();
+    size_t slash = file.find_last_of('/');
+    if (slash == std::string::npos) return ".";
+    return slash == 0 ? "/" : file.substr(0, slash);
+}
+
+/**
+ * Retorna el nombre del archivo de perfil de un directorio de archivos temporales.
+ */
+inline std::string profile_path(const std::string& dir) {
+    return dir + "/.sort_profile";
+}
+
+/**
+ * Lee el perfil guardado de un directorio.
+ *
+ * @return true si existía un perfil válido, dejándolo en `profile`.
+ */
+inline bool load_device_profile(const std::string& dir, DeviceProfile& profile) {
+    FILE* f = fopen(profile_path(dir).c_str(), "r");
+    if (!f) return false;
+    DeviceProfile p;
+    int fields = fscanf(f, "seek_ms %lf\nbandwidth_mb_s %lf\ncpu_ns %lf\n", &p.seek_ms, &p.bandwidth_mb_s, &p.cpu_ns);
+    fclose(f);
+    if (fields != 3 || p.bandwidth_mb_s <= 0) return false;
+    profile = p;
+    return true;
+}
+
+/**
+ * Guarda el perfil de un directorio, para que las próximas ejecuciones no lo midan.
+ */
+inline void save_device_profile(const std::string& dir, const DeviceProfile& profile) {
+    FILE* f = fopen(profile_path(dir).c_str(), "w");
+    if (!f) {
+        fprintf(stderr, "[ERROR] No se pudo guardar el perfil %s\n", profile_path(dir).c_str());
+        return;
+    }
+    fprintf(f, "seek_ms %.6f\nbandwidth_mb_s %.3f\ncpu_ns %.6f\n", profile.seek_ms, profile.bandwidth_mb_s, profile.cpu_ns);
+    fclose(f);
+}
+
+/**
+ * Mide el directorio de archivos temporales con una muestra de los datos.
+ *
+ * @param dir Directorio donde el ordenamiento escribirá sus archivos temporales.
+ * @param sample_source Archivo del que se toma la muestra (los primeros
+ *                      PROFILE_SAMPLE_BYTES); si es más corto se completa con datos aleatorios.
+ *
+ * @return Perfil medido.
+ *
+ * Escribe la muestra en `dir` y la saca del caché de páginas (posix_fadvise) antes de
+ * cada medición: primero la lee completa en forma secuencial (ancho de banda) y luego
+ * lee bloques de 4 KB en posiciones aleatorias; el tiempo de esas lecturas menos el de
+ * su transferencia es el costo de un acceso. El costo por comparación sale de ordenar
+ * la muestra en memoria con std::sort (n log2 n comparaciones).
+ */
+inline DeviceProfile measure_device(const std::string& dir, const std::string& sample_source) {
+    using clock = std::chrono::steady_clock;
+    auto seconds_since = [](clock::time_point t) { return std::chrono::duration<double>(clock::now() - t).count(); };
+    const int64_t block = 4096;
+    const int64_t elements = PROFILE_SAMPLE_BYTES / sizeof(int64_t);
+
+    std::vector<int64_t> data(elements);
+    size_t loaded = 0;
+    if (FILE* src = fopen(sample_source.c_str(), "rb")) {
+        loaded = fread(data.data(), sizeof(int64_t), elements, src);
+        fclose(src);
+    }
+    std::mt19937_64 rng(12345);
+    for (size_t i = loaded; i < data.size(); i++) data[i] = rng();
+
+    std::string sample = dir + "/.sort_profile_sample";
+    int fd = open(sample.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "[ERROR] No se pudo crear %s para medir el directorio\n", sample.c_str());
+        exit(1);
+    }
+    write(fd, data.data(), PROFILE_SAMPLE_BYTES);
+    fdatasync(fd);
+
+    DeviceProfile profile;
+    std::vector<char> buf(1 << 20);
+
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    auto start = clock::now();
+    for (off_t pos = 0; pos < PROFILE_SAMPLE_BYTES; pos += buf.size()) pread(fd, buf.data(), buf.size(), pos);
+    profile.bandwidth_mb_s = PROFILE_SAMPLE_BYTES / (1024.0 * 1024.0) / std::max(seconds_since(start), 1e-6);
+
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    start = clock::now();
+    for (int i = 0; i < PROFILE_RANDOM_READS; i++) {
+        off_t pos = (off_t)(rng() % (PROFILE_SAMPLE_BYTES / block)) * block;
+        pread(fd, buf.data(), block, pos);
+    }
+    double per_read_ms = seconds_since(start) * 1000 / PROFILE_RANDOM_READS;
+    profile.seek_ms = std::max(0.0, per_read_ms - block / (profile.bandwidth_mb_s * 1024 * 1024) * 1000);
+    close(fd);
+    remove(sample.c_str());
+
+    start = clock::now();
+    std::sort(data.begin(), data.end());
+    profile.cpu_ns = seconds_since(start) * 1e9 / (elements * std::log2((double)elements));
+    return profile;
+}
+
+/**
+ * Retorna el perfil del directorio de archivos temporales de `input_file` (ver
+ * `scratch_dir_of`): lo carga si ya fue medido y, si no, lo mide con una muestra de
+ * `input_file` y lo guarda.
+ */
+inline DeviceProfile device_profile_for(const std::string& input_file) {
+    std::string dir = scratch_dir_of(input_file);
+    DeviceProfile profile;
+    if (load_device_profile(dir, profile)) return profile;
+    profile = measure_device(dir, input_file);
+    save_device_profile(dir, profile);
+    return profile;
+}
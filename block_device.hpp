@@ -0,0 +1,669 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <climits>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+
+#include "sort_common.hpp"
+#include "metrics.hpp"
+
+// Formas de abrir un archivo de un BlockDevice
+enum class OpenMode {
+    READ,    // Solo lectura; el archivo debe existir
+    CREATE   // Lectura y escritura; se crea vacío (o se vacía si existía)
+};
+
+/**
+ * Tramo de un archivo proyectado en memoria con mmap; se libera (munmap) al destruirse.
+ *
+ * Métodos:
+ *   data(): puntero al primer byte pedido.
+ *   sync(): encarga al kernel la escritura de lo modificado (msync con MS_ASYNC: como
+ *     los demás backends, deja los datos en el caché de páginas) y la registra en `metrics`.
+ */
+class MappedRange {
+    char* base;
+    size_t length;
+    char* start;
+    size_t bytes;
+
+public:
+    MappedRange(char* base, size_t length, size_t skip, size_t bytes)
+        : base(base), length(length), start(base + skip), bytes(bytes) {}
+    ~MappedRange() { munmap(base, length); }
+
+    MappedRange(const MappedRange&) = delete;
+    MappedRange& operator=(const MappedRange&) = delete;
+
+    void* data() const { return start; }
+
+    void sync() {
+        timed_io(true, [&] { return msync(base, length, MS_ASYNC) == 0 ? bytes : 0; });
+    }
+};
+
+/**
+ * Archivo abierto en un BlockDevice.
+ *
+ * Ofrece lectura y escritura posicional (`read_at` / `write_at`) y secuencial con un
+ * cursor propio (`read` / `write`, que avanzan desde `seek`). Cada operación se
+ * registra en `metrics` como una llamada de E/S, sea cual sea el backend.
+ *
+ * Métodos:
+ *   read_at(buf, bytes, offset) / write_at(buf, bytes, offset): E/S posicional; retornan los bytes transferidos.
+ *   read(buf, bytes) / write(buf, bytes): E/S desde el cursor, que avanza.
+ *   write_gather(iov, count): escribe varios tramos seguidos desde el cursor en una sola operación.
+ *   write_gather_at(iov, count, offset): lo mismo, desde una posición dada.
+ *   seek(offset) / tell(): mueven o consultan el cursor.
+ *   size(): tamaño del archivo en bytes.
+ *   truncate(bytes): fija el tamaño del archivo (para preasignar una salida).
+ *   reserve(bytes): reserva en disco los primeros `bytes` (fallocate) sin escribirlos,
+ *     si el backend lo permite.
+ *   native_fd(): descriptor del sistema sobre el que se puede hacer E/S directamente
+ *     (p. ej. con io_uring), o -1 si el backend no tiene uno.
+ *   direct_io(): indica si el descriptor exige buffers, posiciones y largos alineados a 4 KB.
+ *   note_write(end): avisa que se escribió hasta `end` por fuera de esta interfaz.
+ *   mappable(): indica si `map` está disponible.
+ *   map(offset, bytes): proyecta en memoria el tramo [offset, offset + bytes), que ya
+ *     debe existir en el archivo; retorna nullptr si el backend no lo permite.
+ *   layered(): indica si el archivo guarda sus datos en otro BlockFile (run comprimido,
+ *     espacio temporal). Sus operaciones no se registran en `metrics`: ya las registra el
+ *     archivo de abajo, con los bytes que llegan de verdad al almacenamiento.
+ *   resolve(offset, bytes, for_write, physical): archivo y posición (`physical`) donde
+ *     está guardado el tramo [offset, offset + bytes) de forma contigua, para hacer la E/S
+ *     directamente sobre él; si es una escritura, reserva el espacio. Retorna este mismo
+ *     archivo si no se apoya en otro o si el tramo no es contiguo.
+ *   io_queue(): identifica el dispositivo donde está el archivo; las operaciones en
+ *     segundo plano sobre archivos de la misma cola las hace un mismo hilo, en orden.
+ */
+class BlockFile {
+    int64_t cursor = 0;
+
+protected:
+    virtual size_t do_read(void* buf, size_t bytes, int64_t offset) = 0;
+    virtual size_t do_write(const void* buf, size_t bytes, int64_t offset) = 0;
+
+    virtual size_t do_write_gather(const iovec* iov, size_t count, int64_t offset) {
+        size_t total = 0;
+        for (size_t i = 0; i < count; i++) total += do_write(iov[i].iov_base, iov[i].iov_len, offset + total);
+        return total;
+    }
+
+public:
+    virtual ~BlockFile() = default;
+    virtual int64_t size() = 0;
+    virtual void truncate(int64_t bytes) = 0;
+    virtual void reserve(int64_t) {}
+    virtual int native_fd() const { return -1; }
+    virtual bool direct_io() const { return false; }
+    virtual void note_write(int64_t) {}
+    virtual bool mappable() const { return false; }
+    virtual std::unique_ptr<MappedRange> map(int64_t, size_t) { return nullptr; }
+    virtual bool layered() const { return false; }
+    virtual const void* io_queue() const { return nullptr; }
+
+    virtual BlockFile* resolve(int64_t offset, size_t, bool, int64_t& physical) {
+        physical = offset;
+        return this;
+    }
+
+    size_t read_at(void* buf, size_t bytes, int64_t offset) {
+        if (layered()) return do_read(buf, bytes, offset);
+        return timed_io(false, [&] { return do_read(buf, bytes, offset); });
+    }
+
+    size_t write_at(const void* buf, size_t bytes, int64_t offset) {
+        if (layered()) return do_write(buf, bytes, offset);
+        return timed_io(true, [&] { return do_write(buf, bytes, offset); });
+    }
+
+    size_t read(void* buf, size_t bytes) {
+        size_t n = read_at(buf, bytes, cursor);
+        cursor += n;
+        return n;
+    }
+
+    size_t write(const void* buf, size_t bytes) {
+        size_t n = write_at(buf, bytes, cursor);
+        cursor += n;
+        return n;
+    }
+
+    size_t write_gather_at(const iovec* iov, size_t count, int64_t offset) {
+        if (layered()) return do_write_gather(iov, count, offset);
+        return timed_io(true, [&] { return do_write_gather(iov, count, offset); });
+    }
+
+    size_t write_gather(const iovec* iov, size_t count) {
+        size_t n = write_gather_at(iov, count, cursor);
+        cursor += n;
+        return n;
+    }
+
+    void seek(int64_t offset) { cursor = offset; }
+    int64_t tell() const { return cursor; }
+};
+
+/**
+ * Almacenamiento donde el ordenamiento lee la entrada y escribe sus archivos temporales
+ * y la salida. Todos los accesos de MergeSort y QuickSort pasan por aquí, así que el
+ * backend se puede cambiar sin tocar los algoritmos.
+ *
+ * Métodos:
+ *   open(name, mode): abre un archivo; termina el programa si no se puede.
+ *   remove(name): borra un archivo (si existe).
+ *   rename(from, to): renombra un archivo; retorna false si no se pudo.
+ *   persist(name): deja el archivo en el sistema de archivos real (solo importa en el
+ *     disco simulado).
+ *   describe(): descripción del backend, para los reportes.
+ */
+class BlockDevice {
+public:
+    virtual ~BlockDevice() = default;
+    virtual std::unique_ptr<BlockFile> open(const std::string& name, OpenMode mode) = 0;
+    virtual void remove(const std::string& name) { ::remove(name.c_str()); }
+    virtual bool rename(const std::string& from, const std::string& to) { return ::rename(from.c_str(), to.c_str()) == 0; }
+    virtual void persist(const std::string&) {}
+    virtual std::string describe() const = 0;
+};
+
+/**
+ * Backend con stdio (FILE* con buffer). Solo hace fseek cuando la operación no sigue a
+ * la anterior, así que la E/S secuencial conserva el buffer de stdio. Un mutex por
+ * archivo permite que varios hilos escriban en posiciones distintas del mismo archivo.
+ */
+class StdioFile : public BlockFile {
+    FILE* f;
+    int64_t pos = 0;
+    bool last_write = false;
+    std::mutex mtx;
+
+    void position(int64_t offset, bool writing) {
+        if (offset != pos || writing != last_write) fseek(f, offset, SEEK_SET);
+        pos = offset;
+        last_write = writing;
+    }
+
+protected:
+    size_t do_read(void* buf, size_t bytes, int64_t offset) override {
+        std::lock_guard<std::mutex> lock(mtx);
+        position(offset, false);
+        size_t n = fread(buf, 1, bytes, f);
+        pos += n;
+        return n;
+    }
+
+    size_t do_write(const void* buf, size_t bytes, int64_t offset) override {
+        std::lock_guard<std::mutex> lock(mtx);
+        position(offset, true);
+        size_t n = fwrite(buf, 1, bytes, f);
+        pos += n;
+        return n;
+    }
+
+public:
+    explicit StdioFile(FILE* f) : f(f) {}
+    ~StdioFile() override { fclose(f); }
+
+    int64_t size() override {
+        std::lock_guard<std::mutex> lock(mtx);
+        fflush(f);
+        struct stat st;
+        fstat(fileno(f), &st);
+        return st.st_size;
+    }
+
+    void truncate(int64_t bytes) override {
+        std::lock_guard<std::mutex> lock(mtx);
+        fflush(f);
+        ftruncate(fileno(f), bytes);
+    }
+
+    void reserve(int64_t bytes) override {
+        std::lock_guard<std::mutex> lock(mtx);
+        fflush(f);
+        posix_fallocate(fileno(f), 0, bytes);
+    }
+};
+
+class StdioDevice : public BlockDevice {
+public:
+    std::unique_ptr<BlockFile> open(const std::string& name, OpenMode mode) override {
+        FILE* f = fopen(name.c_str(), mode == OpenMode::READ ? "rb" : "w+b");
+        if (!f) {
+            fprintf(stderr, "[ERROR] No se pudo abrir %s\n", name.c_str());
+            exit(1);
+        }
+        return std::make_unique<StdioFile>(f);
+    }
+
+    std::string describe() const override { return "stdio"; }
+};
+
+// Bloques del buffer intermedio de las operaciones no alineadas con O_DIRECT
+const int64_t DIRECT_BOUNCE_BLOCKS = 16;
+
+/**
+ * Backend con pread/pwrite y O_DIRECT, sin pasar por el caché de páginas (o sin
+ * O_DIRECT, con `DirectDevice(false)`). Con `DirectDevice(false, true)` los archivos
+ * además se pueden proyectar en memoria (`map`).
+ *
+ * O_DIRECT exige que el buffer, la posición y el largo estén alineados a 4 KB: las
+ * operaciones alineadas (la mayoría, porque los buffers salen de `memory_arena`, que
+ * está alineada) van directo al disco; las demás pasan, por tramos, por un buffer
+ * intermedio alineado de DIRECT_BOUNCE_BLOCKS bloques bajo un mutex y, al escribir, solo
+ * se leen antes los bloques de los bordes que quedan incompletos. Como el disco se
+ * escribe por bloques completos, el archivo se recorta a su largo real al cerrarlo.
+ * Si el sistema de archivos no acepta O_DIRECT (p. ej. tmpfs) se usa pread/pwrite normal.
+ */
+class DirectFile : public BlockFile {
+    int fd;
+    bool direct;
+    bool writable;
+    bool use_mmap;
+    int64_t logical_size = 0;
+    char* bounce = nullptr;  // Buffer intermedio de las operaciones no alineadas (con mtx)
+    std::mutex mtx;
+
+    static bool aligned(const void* buf, size_t bytes, int64_t offset) {
+        return (uintptr_t)buf % BLOCK_SIZE == 0 && bytes % BLOCK_SIZE == 0 && offset % BLOCK_SIZE == 0;
+    }
+
+    static size_t full_pread(int fd, void* buf, size_t bytes, int64_t offset) {
+        size_t done = 0;
+        while (done < bytes) {
+            ssize_t n = pread(fd, (char*)buf + done, bytes - done, offset + done);
+            if (n <= 0) break;
+            done += n;
+        }
+        return done;
+    }
+
+    static size_t full_pwrite(int fd, const void* buf, size_t bytes, int64_t offset) {
+        size_t done = 0;
+        while (done < bytes) {
+            ssize_t n = pwrite(fd, (const char*)buf + done, bytes - done, offset + done);
+            if (n <= 0) break;
+            done += n;
+        }
+        return done;
+    }
+
+    char* bounce_buffer() {
+        if (!bounce) bounce = (char*)aligned_alloc(BLOCK_SIZE, DIRECT_BOUNCE_BLOCKS * BLOCK_SIZE);
+        return bounce;
+    }
+
+    /**
+     * Recorre [offset, offset + bytes) en tramos alineados de a lo más DIRECT_BOUNCE_BLOCKS
+     * bloques: `step(first, last, from, to)` recibe el tramo alineado [first, last) y la
+     * parte [from, to) de la operación que cae en él.
+     */
+    template <typename Step>
+    static void for_each_bounce(int64_t offset, size_t bytes, Step step) {
+        int64_t end = offset + (int64_t)bytes;
+        int64_t first = offset / BLOCK_SIZE * BLOCK_SIZE;
+        while (first < end) {
+            int64_t last = std::min<int64_t>(first + DIRECT_BOUNCE_BLOCKS * BLOCK_SIZE,
+                                             (end + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_SIZE);
+            step(first, last, std::max(first, offset), std::min(last, end));
+            first = last;
+        }
+    }
+
+protected:
+    size_t do_read(void* buf, size_t bytes, int64_t offset) override {
+        int64_t end = std::min<int64_t>(offset + bytes, size());
+        if (end <= offset) return 0;
+        bytes = end - offset;
+        if (!direct) return full_pread(fd, buf, bytes, offset);
+        if (aligned(buf, bytes, offset)) return full_pread(fd, buf, bytes, offset);
+        std::lock_guard<std::mutex> lock(mtx);
+        char* data = bounce_buffer();
+        for_each_bounce(offset, bytes, [&](int64_t first, int64_t last, int64_t from, int64_t to) {
+            full_pread(fd, data, last - first, first);
+            memcpy((char*)buf + (from - offset), data + (from - first), to - from);
+        });
+        return bytes;
+    }
+
+    size_t do_write(const void* buf, size_t bytes, int64_t offset) override {
+        size_t n;
+        if (!direct || aligned(buf, bytes, offset)) {
+            n = full_pwrite(fd, buf, bytes, offset);
+        } else {
+            std::lock_guard<std::mutex> lock(mtx);
+            char* data = bounce_buffer();
+            n = bytes;
+            for_each_bounce(offset, bytes, [&](int64_t first, int64_t last, int64_t from, int64_t to) {
+                // Solo los bloques de los bordes que la escritura no cubre completos se leen antes
+                if (from > first) {
+                    memset(data, 0, BLOCK_SIZE);
+                    full_pread(fd, data, BLOCK_SIZE, first);
+                }
+                if (to < last && !(from > first && last - first == BLOCK_SIZE)) {
+                    memset(data + (last - first - BLOCK_SIZE), 0, BLOCK_SIZE);
+                    full_pread(fd, data + (last - first - BLOCK_SIZE), BLOCK_SIZE, last - BLOCK_SIZE);
+                }
+                memcpy(data + (from - first), (const char*)buf + (from - offset), to - from);
+                if (full_pwrite(fd, data, last - first, first) < (size_t)(last - first)) n = 0;
+            });
+        }
+        std::lock_guard<std::mutex> lock(mtx);
+        logical_size = std::max<int64_t>(logical_size, offset + n);
+        return n;
+    }
+
+    size_t do_write_gather(const iovec* iov, size_t count, int64_t offset) override {
+        bool all_aligned = offset % BLOCK_SIZE == 0;
+        size_t bytes = 0;
+        for (size_t i = 0; i < count; i++) {
+            all_aligned = all_aligned && (i + 1 == count || aligned(iov[i].iov_base, iov[i].iov_len, 0));
+            bytes += iov[i].iov_len;
+        }
+        // Solo el último tramo puede quedar incompleto; sin O_DIRECT cualquier tramo sirve
+        if (direct && (!all_aligned || !aligned(iov[count - 1].iov_base, iov[count - 1].iov_len, 0))) {
+            return BlockFile::do_write_gather(iov, count, offset);
+        }
+        size_t done = 0;
+        for (size_t i = 0; i < count; i += IOV_MAX) {
+            ssize_t n = pwritev(fd, iov + i, std::min<size_t>(IOV_MAX, count - i), offset + done);
+            if (n <= 0) break;
+            done += n;
+        }
+        std::lock_guard<std::mutex> lock(mtx);
+        logical_size = std::max<int64_t>(logical_size, offset + done);
+        return done;
+    }
+
+public:
+    DirectFile(int fd, bool direct, bool writable, bool use_mmap = false)
+        : fd(fd), direct(direct), writable(writable), use_mmap(use_mmap) {
+        if (!writable) {
+            struct stat st;
+            fstat(fd, &st);
+            logical_size = st.st_size;
+        }
+    }
+
+    ~DirectFile() override {
+        if (writable && direct) ftruncate(fd, logical_size);
+        close(fd);
+        free(bounce);
+    }
+
+    int64_t size() override {
+        std::lock_guard<std::mutex> lock(mtx);
+        return logical_size;
+    }
+
+    int native_fd() const override { return fd; }
+    bool direct_io() const override { return direct; }
+
+    void note_write(int64_t end) override {
+        std::lock_guard<std::mutex> lock(mtx);
+        logical_size = std::max(logical_size, end);
+    }
+
+    bool mappable() const override { return use_mmap; }
+
+    std::unique_ptr<MappedRange> map(int64_t offset, size_t bytes) override {
+        if (!use_mmap || bytes == 0) return nullptr;
+        int64_t page = sysconf(_SC_PAGESIZE);
+        int64_t first = offset / page * page;
+        size_t length = offset + bytes - first;
+        void* base = mmap(nullptr, length, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, first);
+        if (base == MAP_FAILED) return nullptr;
+        // Sugerencias: el error se ignora si el kernel o el sistema de archivos no las aceptan
+        madvise(base, length, MADV_SEQUENTIAL);
+        madvise(base, length, MADV_HUGEPAGE);
+        return std::make_unique<MappedRange>((char*)base, length, offset - first, bytes);
+    }
+
+    void truncate(int64_t bytes) override {
+        std::lock_guard<std::mutex> lock(mtx);
+        ftruncate(fd, bytes);
+        // Un archivo proyectado debe tener sus bloques reservados: si no, escribir en la
+        // proyección sin espacio en disco termina con SIGBUS en vez de un error
+        if (use_mmap && bytes > 0) posix_fallocate(fd, 0, bytes);
+        logical_size = bytes;
+    }
+
+    void reserve(int64_t bytes) override {
+        // El error se ignora: sin fallocate los bloques se asignan al escribirlos
+        if (bytes > 0) posix_fallocate(fd, 0, bytes);
+    }
+};
+
+class DirectDevice : public BlockDevice {
+    bool use_direct;
+    bool use_mmap;
+    bool warned = false;
+
+public:
+    explicit DirectDevice(bool use_direct = true, bool use_mmap = false) : use_direct(use_direct), use_mmap(use_mmap) {}
+
+    std::unique_ptr<BlockFile> open(const std::string& name, OpenMode mode) override {
+        int flags = mode == OpenMode::READ ? O_RDONLY : O_RDWR | O_CREAT | O_TRUNC;
+        int fd = ::open(name.c_str(), flags | (use_direct ? O_DIRECT : 0), 0644);
+        bool direct = use_direct && fd >= 0;
+        if (use_direct && fd < 0 && errno == EINVAL) {
+            if (!warned) fprintf(stderr, "[INFO] El sistema de archivos no acepta O_DIRECT; se usa pread/pwrite normal\n");
+            warned = true;
+            fd = ::open(name.c_str(), flags, 0644);
+        }
+        if (fd < 0) {
+            fprintf(stderr, "[ERROR] No se pudo abrir %s\n", name.c_str());
+            exit(1);
+        }
+        return std::make_unique<DirectFile>(fd, direct, mode != OpenMode::READ, use_mmap);
+    }
+
+    std::string describe() const override { return use_direct ? "direct" : use_mmap ? "mmap" : "pread"; }
+};
+
+/**
+ * Disco simulado en memoria, con latencia de acceso y ancho de banda configurables.
+ *
+ * Los archivos viven en memoria; uno que no existe se carga del sistema de archivos
+ * real la primera vez que se abre para lectura (sin costo), y `persist` lo escribe de
+ * vuelta. Cada operación avanza un reloj simulado: si no empieza donde terminó la
+ * anterior (mismo archivo y posición) cuesta un acceso aleatorio de `seek_ms`, y la
+ * transferencia cuesta bytes / ancho de banda. El tiempo, los accesos y los bytes no
+ * dependen de la máquina, así que las mediciones son reproducibles.
+ *
+ * Constructor:
+ *   SimulatedDevice(seek_ms, bandwidth_mb_s)
+ *
+ * Métodos:
+ *   seconds(): tiempo simulado acumulado.
+ *   seeks(): accesos aleatorios simulados.
+ */
+class SimulatedDevice : public BlockDevice {
+    struct Data {
+        std::vector<char> bytes;
+    };
+
+    class SimFile : public BlockFile {
+        SimulatedDevice& dev;
+        std::shared_ptr<Data> data;
+
+    protected:
+        size_t do_read(void* buf, size_t bytes, int64_t offset) override {
+            std::lock_guard<std::mutex> lock(dev.mtx);
+            int64_t end = std::min<int64_t>(offset + bytes, data->bytes.size());
+            size_t n = end > offset ? end - offset : 0;
+            if (n > 0) memcpy(buf, data->bytes.data() + offset, n);
+            dev.charge(data.get(), offset, n);
+            return n;
+        }
+
+        size_t do_write(const void* buf, size_t bytes, int64_t offset) override {
+            std::lock_guard<std::mutex> lock(dev.mtx);
+            if ((int64_t)data->bytes.size() < offset + (int64_t)bytes) data->bytes.resize(offset + bytes);
+            memcpy(data->bytes.data() + offset, buf, bytes);
+            dev.charge(data.get(), offset, bytes);
+            return bytes;
+        }
+
+    public:
+        SimFile(SimulatedDevice& dev, std::shared_ptr<Data> data) : dev(dev), data(std::move(data)) {}
+
+        int64_t size() override {
+            std::lock_guard<std::mutex> lock(dev.mtx);
+            return data->bytes.size();
+        }
+
+        void truncate(int64_t bytes) override {
+            std::lock_guard<std::mutex> lock(dev.mtx);
+            data->bytes.resize(bytes);
+        }
+    };
+
+    double seek_ms, bandwidth_mb_s;
+    std::mutex mtx;
+    std::map<std::string, std::shared_ptr<Data>> files;
+    const Data* head_file = nullptr;
+    int64_t head_offset = 0;
+    double elapsed = 0;
+    long seek_count = 0;
+
+    void charge(const Data* file, int64_t offset, size_t bytes) {
+        if (file != head_file || offset != head_offset) {
+            elapsed += seek_ms / 1000;
+            seek_count++;
+        }
+        elapsed += bytes / (bandwidth_mb_s * 1024 * 1024);
+        head_file = file;
+        head_offset = offset + bytes;
+    }
+
+public:
+    SimulatedDevice(double seek_ms, double bandwidth_mb_s) : seek_ms(seek_ms), bandwidth_mb_s(bandwidth_mb_s) {}
+
+    std::unique_ptr<BlockFile> open(const std::string& name, OpenMode mode) override {
+        std::lock_guard<std::mutex> lock(mtx);
+        auto it = files.find(name);
+        if (mode == OpenMode::CREATE) {
+            auto data = std::make_shared<Data>();
+            files[name] = data;
+            return std::make_unique<SimFile>(*this, data);
+        }
+        if (it == files.end()) {
+            FILE* f = fopen(name.c_str(), "rb");
+            if (!f) {
+                fprintf(stderr, "[ERROR] No se pudo abrir %s\n", name.c_str());
+                exit(1);
+            }
+            auto data = std::make_shared<Data>();
+            fseek(f, 0, SEEK_END);
+            data->bytes.resize(ftell(f));
+            fseek(f, 0, SEEK_SET);
+            fread(data->bytes.data(), 1, data->bytes.size(), f);
+            fclose(f);
+            it = files.emplace(name, data).first;
+        }
+        return std::make_unique<SimFile>(*this, it->second);
+    }
+
+    void remove(const std::string& name) override {
+        std::lock_guard<std::mutex> lock(mtx);
+        files.erase(name);
+    }
+
+    bool rename(const std::string& from, const std::string& to) override {
+        std::lock_guard<std::mutex> lock(mtx);
+        auto it = files.find(from);
+        if (it == files.end()) return false;
+        files[to] = it->second;
+        files.erase(it);
+        return true;
+    }
+
+    void persist(const std::string& name) override {
+        std::lock_guard<std::mutex> lock(mtx);
+        auto it = files.find(name);
+        if (it == files.end()) return;
+        FILE* f = fopen(name.c_str(), "wb");
+        if (!f) {
+            fprintf(stderr, "[ERROR] No se pudo escribir %s\n", name.c_str());
+            exit(1);
+        }
+        fwrite(it->second->bytes.data(), 1, it->second->bytes.size(), f);
+        fclose(f);
+    }
+
+    std::string describe() const override {
+        char buf[96];
+        snprintf(buf, sizeof(buf), "sim (acceso %.3f ms, %.1f MB/s)", seek_ms, bandwidth_mb_s);
+        return buf;
+    }
+
+    double seconds() {
+        std::lock_guard<std::mutex> lock(mtx);
+        return elapsed;
+    }
+
+    long seeks() {
+        std::lock_guard<std::mutex> lock(mtx);
+        return seek_count;
+    }
+};
+
+/**
+ * Retorna el almacenamiento que usan los ordenamientos (stdio si no se eligió otro).
+ */
+inline std::unique_ptr<BlockDevice>& block_device_ptr() {
+    static std::unique_ptr<BlockDevice> device = std::make_unique<StdioDevice>();
+    return device;
+}
+
+inline BlockDevice& block_device() {
+    return *block_device_ptr();
+}
+
+/**
+ * Interpreta el nombre de un backend de almacenamiento: "stdio", "direct", "pread", "mmap", "sim:hdd"
+ * (8 ms por acceso, 150 MB/s), "sim:ssd" (0.1 ms, 2000 MB/s) o "sim:<ms>:<MB/s>".
+ *
+ * @return true si el nombre es válido, dejando el backend elegido en `block_device()`.
+ */
+inline bool parse_block_device(const std::string& name) {
+    double seek_ms, mb_s;
+    if (name == "stdio") block_device_ptr() = std::make_unique<StdioDevice>();
+    else if (name == "direct") block_device_ptr() = std::make_unique<DirectDevice>(true);
+    else if (name == "pread") block_device_ptr() = std::make_unique<DirectDevice>(false);
+    else if (name == "mmap") block_device_ptr() = std::make_unique<DirectDevice>(false, true);
+    else if (name == "sim" || name == "sim:hdd") block_device_ptr() = std::make_unique<SimulatedDevice>(8.0, 150.0);
+    else if (name == "sim:ssd") block_device_ptr() = std::make_unique<SimulatedDevice>(0.1, 2000.0);
+    else if (sscanf(name.c_str(), "sim:%lf:%lf", &seek_ms, &mb_s) == 2 && mb_s > 0) {
+        block_device_ptr() = std::make_unique<SimulatedDevice>(seek_ms, mb_s);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Imprime el almacenamiento usado y, si es el disco simulado, su tiempo y accesos.
+ */
+inline void print_block_device_summary() {
+    printf("Almacenamiento: %s\n", block_device().describe().c_str());
+    if (auto* sim = dynamic_cast<SimulatedDevice*>(&block_device())) {
+        printf("Tiempo simulado de E/S: %.3f s (%ld accesos aleatorios)\n", sim->seconds(), sim->seeks());
+    }
+}
@@ -0,0 +1,351 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+// <linux/fs.h>, que incluye io_uring.h, define una macro BLOCK_SIZE que taparía la de sort_common.hpp
+#undef BLOCK_SIZE
+
+#include "sort_common.hpp"
+#include "metrics.hpp"
+#include "block_device.hpp"
+#include "async_io.hpp"
+
+/**
+ * Anillo de io_uring, usado directamente con las llamadas al sistema (sin liburing).
+ *
+ * Métodos:
+ *   init(entries): crea el anillo; retorna false si el kernel no tiene io_uring.
+ *   space(): entradas libres en la cola de envío.
+ *   prepare(opcode, fd, iov, count, offset, user_data): encola una operación vectorial
+ *     (IORING_OP_READV / IORING_OP_WRITEV) sin enviarla.
+ *   enter(wait_for): envía lo encolado y, si wait_for > 0, bloquea hasta que haya al
+ *     menos esa cantidad de operaciones completadas.
+ *   pop(user_data, res): retira una operación completada; retorna false si no hay.
+ */
+class IoUring {
+    int ring_fd = -1;
+    unsigned entries = 0, to_submit = 0;
+    void* sq_ptr = MAP_FAILED;
+    void* cq_ptr = MAP_FAILED;
+    size_t sq_size = 0, cq_size = 0;
+    io_uring_sqe* sqes = (io_uring_sqe*)MAP_FAILED;
+    unsigned *sq_head = nullptr, *sq_tail = nullptr, *sq_mask = nullptr, *sq_array = nullptr;
+    unsigned *cq_head = nullptr, *cq_tail = nullptr, *cq_mask = nullptr;
+    io_uring_cqe* cqes = nullptr;
+
+public:
+    IoUring() = default;
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    ~IoUring() {
+        if (sqes != MAP_FAILED) munmap(sqes, entries * sizeof(io_uring_sqe));
+        if (cq_ptr != MAP_FAILED && cq_ptr != sq_ptr) munmap(cq_ptr, cq_size);
+        if (sq_ptr != MAP_FAILED) munmap(sq_ptr, sq_size);
+        if (ring_fd >= 0) close(ring_fd);
+    }
+
+    bool init(unsigned wanted) {
+        io_uring_params p;
+        memset(&p, 0, sizeof(p));
+        ring_fd = syscall(__NR_io_uring_setup, wanted, &p);
+        if (ring_fd < 0) return false;
+        entries = p.sq_entries;
+
+        sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cq_size = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+        if (single) sq_size = cq_size = std::max(sq_size, cq_size);
+
+        sq_ptr = mmap(nullptr, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+        if (sq_ptr == MAP_FAILED) return false;
+        cq_ptr = single ? sq_ptr
+                        : mmap(nullptr, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+        if (cq_ptr == MAP_FAILED) return false;
+        sqes = (io_uring_sqe*)mmap(nullptr, entries * sizeof(io_uring_sqe), PROT_READ | PROT_WRITE,
+                                   MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) return false;
+
+        char* sq = (char*)sq_ptr;
+        sq_head = (unsigned*)(sq + p.sq_off.head);
+        sq_tail = (unsigned*)(sq + p.sq_off.tail);
+        sq_mask = (unsigned*)(sq + p.sq_off.ring_mask);
+        sq_array = (unsigned*)(sq + p.sq_off.array);
+        char* cq = (char*)cq_ptr;
+        cq_head = (unsigned*)(cq + p.cq_off.head);
+        cq_tail = (unsigned*)(cq + p.cq_off.tail);
+        cq_mask = (unsigned*)(cq + p.cq_off.ring_mask);
+        cqes = (io_uring_cqe*)(cq + p.cq_off.cqes);
+        return true;
+    }
+
+    unsigned space() const {
+        return entries - (*sq_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE));
+    }
+
+    void prepare(uint8_t opcode, int fd, const iovec* iov, unsigned count, int64_t offset, uint64_t user_data) {
+        unsigned tail = *sq_tail;
+        unsigned index = tail & *sq_mask;
+        io_uring_sqe* sqe = &sqes[index];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = opcode;
+        sqe->fd = fd;
+        sqe->addr = (uint64_t)(uintptr_t)iov;
+        sqe->len = count;
+        sqe->off = offset;
+        sqe->user_data = user_data;
+        sq_array[index] = index;
+        __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+        to_submit++;
+    }
+
+    bool enter(unsigned wait_for) {
+        unsigned flags = wait_for > 0 ? IORING_ENTER_GETEVENTS : 0;
+        while (to_submit > 0 || wait_for > 0) {
+            int n = syscall(__NR_io_uring_enter, ring_fd, to_submit, wait_for, flags, nullptr, 0);
+            if (n < 0) {
+                if (errno == EINTR || errno == EAGAIN || errno == EBUSY) continue;
+                return false;
+            }
+            to_submit -= std::min<unsigned>(to_submit, n);
+            if (to_submit == 0) break;
+        }
+        return true;
+    }
+
+    bool pop(uint64_t& user_data, int& res) {
+        unsigned head = *cq_head;
+        if (head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) return false;
+        const io_uring_cqe& cqe = cqes[head & *cq_mask];
+        user_data = cqe.user_data;
+        res = cqe.res;
+        __atomic_store_n(cq_head, head + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+};
+
+// Operaciones que IOEngine mantiene a la vez en el anillo de io_uring
+const unsigned IO_ENGINE_DEPTH = 64;
+
+/**
+ * Motor de E/S asíncrona por lotes.
+ *
+ * Las lecturas y escrituras se encolan con `read` / `write` / `write_gather` (cada una
+ * recibe un ticket) y se envían juntas con `submit`, así que muchas operaciones pequeñas
+ * (bloques de partición, recargas de runs) cuestan una sola llamada al sistema y
+ * quedan varias en curso a la vez. Con io_uring las completadas se recogen desde el
+ * hilo que llama, sin hilos extra; si el kernel no tiene io_uring, o el archivo no tiene
+ * un descriptor propio (stdio, disco simulado) o no está alineado para O_DIRECT, la
+ * operación la hace un hilo de E/S en segundo plano (`IOThread`) con la interfaz de
+ * BlockFile; hay un hilo por dispositivo (`BlockFile::io_queue`), así que los discos
+ * del espacio temporal trabajan en paralelo y cada archivo se atiende en orden. Un
+ * archivo que guarda sus datos en otro (espacio temporal) se traduce antes con
+ * `resolve`, de modo que sus tramos contiguos también van al anillo. Las operaciones
+ * son independientes: pueden terminar en cualquier orden.
+ *
+ * Métodos:
+ *   read(file, buf, bytes, offset) / write(file, buf, bytes, offset): encolan una operación.
+ *   write_gather(file, iov, count, offset): encola una escritura de varios tramos
+ *     seguidos (la lista se copia; los datos deben seguir vivos hasta que termine).
+ *   submit(): envía todo lo encolado.
+ *   ready(ticket): indica, sin bloquear, si la operación terminó.
+ *   wait(ticket): envía lo pendiente, bloquea hasta que la operación termine y retorna
+ *     los bytes transferidos. Cada ticket se espera una sola vez.
+ *   drain(): espera todas las operaciones encargadas.
+ *   uses_io_uring(): indica si el motor tiene un anillo de io_uring.
+ */
+class IOEngine {
+    struct Request {
+        BlockFile* file;
+        bool is_write;
+        std::vector<iovec> iov;
+        int64_t offset;
+        size_t bytes = 0;
+        size_t result = 0;
+        bool on_ring = false;
+        bool done = false;
+        const void* queue = nullptr;
+        IOThread* thread = nullptr;
+        uint64_t thread_ticket = 0;
+    };
+
+    IoUring ring;
+    bool have_ring = false;
+    std::map<const void*, std::unique_ptr<IOThread>> threads;  // Un hilo por dispositivo (`io_queue`)
+    std::map<uint64_t, Request> requests;
+    std::vector<uint64_t> queued;
+    uint64_t next_ticket = 1;
+    unsigned on_ring = 0;
+
+    bool fits_ring(const Request& r) const {
+        if (!have_ring || r.file->native_fd() < 0) return false;
+        if (!r.file->direct_io()) return true;
+        if (r.offset % BLOCK_SIZE != 0) return false;
+        for (const iovec& v : r.iov) {
+            if ((uintptr_t)v.iov_base % BLOCK_SIZE != 0 || v.iov_len % BLOCK_SIZE != 0) return false;
+        }
+        return true;
+    }
+
+    // Termina con la E/S normal lo que io_uring dejó a medias
+    void finish_short(Request& r, size_t done) {
+        size_t skip = done;
+        for (const iovec& v : r.iov) {
+            if (skip >= v.iov_len) {
+                skip -= v.iov_len;
+                continue;
+            }
+            size_t wanted = v.iov_len - skip;
+            int64_t pos = r.offset + done;
+            size_t n = r.is_write ? r.file->write_at((const char*)v.iov_base + skip, wanted, pos)
+                                  : r.file->read_at((char*)v.iov_base + skip, wanted, pos);
+            done += n;
+            skip = 0;
+            if (n < wanted) break;
+        }
+        r.result = done;
+    }
+
+    void complete(uint64_t ticket, int res) {
+        Request& r = requests.at(ticket);
+        on_ring--;
+        if (res < 0) {
+            fprintf(stderr, "[ERROR] Falló una operación de io_uring: %s\n", strerror(-res));
+            exit(1);
+        }
+        if (r.is_write) metrics.record_write(res, 0);
+        else metrics.record_read(res, 0);
+        r.result = res;
+        if ((size_t)res < r.bytes && (r.is_write || res > 0)) finish_short(r, res);
+        if (r.is_write) r.file->note_write(r.offset + r.result);
+        r.done = true;
+    }
+
+    void reap() {
+        uint64_t ticket;
+        int res;
+        while (ring.pop(ticket, res)) complete(ticket, res);
+    }
+
+    uint64_t enqueue(BlockFile* file, bool is_write, std::vector<iovec> iov, int64_t offset) {
+        uint64_t ticket = next_ticket++;
+        Request& r = requests[ticket];
+        r.file = file;
+        r.is_write = is_write;
+        r.iov = std::move(iov);
+        r.offset = offset;
+        for (const iovec& v : r.iov) r.bytes += v.iov_len;
+        queued.push_back(ticket);
+        return ticket;
+    }
+
+public:
+    IOEngine() { have_ring = ring.init(IO_ENGINE_DEPTH); }
+
+    ~IOEngine() { drain(); }
+
+    IOEngine(const IOEngine&) = delete;
+    IOEngine& operator=(const IOEngine&) = delete;
+
+    uint64_t read(BlockFile* file, void* buf, size_t bytes, int64_t offset) {
+        return enqueue(file, false, {{buf, bytes}}, offset);
+    }
+
+    uint64_t write(BlockFile* file, const void* buf, size_t bytes, int64_t offset) {
+        return enqueue(file, true, {{(void*)buf, bytes}}, offset);
+    }
+
+    uint64_t write_gather(BlockFile* file, const iovec* iov, size_t count, int64_t offset) {
+        return enqueue(file, true, std::vector<iovec>(iov, iov + count), offset);
+    }
+
+    void submit() {
+        for (uint64_t ticket : queued) {
+            Request& r = requests.at(ticket);
+            r.queue = r.file->io_queue();
+            if (r.bytes > 0) r.file = r.file->resolve(r.offset, r.bytes, r.is_write, r.offset);
+            if (fits_ring(r)) {
+                while (ring.space() == 0 || on_ring == IO_ENGINE_DEPTH) {
+                    if (!ring.enter(on_ring == IO_ENGINE_DEPTH ? 1 : 0)) {
+                        fprintf(stderr, "[ERROR] Falló io_uring_enter: %s\n", strerror(errno));
+                        exit(1);
+                    }
+                    reap();
+                }
+                // Más de IOV_MAX tramos no caben en una operación: el resto lo completa finish_short
+                unsigned count = std::min<size_t>(r.iov.size(), IOV_MAX);
+                ring.prepare(r.is_write ? IORING_OP_WRITEV : IORING_OP_READV, r.file->native_fd(), r.iov.data(), count,
+                             r.offset, ticket);
+                r.on_ring = true;
+                on_ring++;
+            } else {
+                auto& thread = threads[r.queue];
+                if (!thread) thread = std::make_unique<IOThread>();
+                Request* req = &r;
+                r.thread = thread.get();
+                r.thread_ticket = thread->submit([req] {
+                    req->result = req->is_write ? req->file->write_gather_at(req->iov.data(), req->iov.size(), req->offset)
+                                                : req->file->read_at(req->iov[0].iov_base, req->iov[0].iov_len, req->offset);
+                });
+            }
+        }
+        queued.clear();
+        if (have_ring && !ring.enter(0)) {
+            fprintf(stderr, "[ERROR] Falló io_uring_enter: %s\n", strerror(errno));
+            exit(1);
+        }
+    }
+
+    bool ready(uint64_t ticket) {
+        Request& r = requests.at(ticket);
+        if (r.on_ring) {
+            if (!r.done) reap();
+            return r.done;
+        }
+        return r.thread_ticket != 0 && r.thread->done(r.thread_ticket);
+    }
+
+    size_t wait(uint64_t ticket) {
+        if (ticket == 0) return 0;
+        if (std::find(queued.begin(), queued.end(), ticket) != queued.end()) submit();
+        Request& r = requests.at(ticket);
+        if (r.on_ring) {
+            reap();
+            if (!r.done) {
+                auto start = std::chrono::steady_clock::now();
+                while (!r.done) {
+                    if (!ring.enter(1)) {
+                        fprintf(stderr, "[ERROR] Falló io_uring_enter: %s\n", strerror(errno));
+                        exit(1);
+                    }
+                    reap();
+                }
+                metrics.record_wait(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+            }
+        } else {
+            r.thread->wait(r.thread_ticket);
+        }
+        size_t result = r.result;
+        requests.erase(ticket);
+        return result;
+    }
+
+    void drain() {
+        if (!queued.empty()) submit();
+        while (!requests.empty()) wait(requests.begin()->first);
+    }
+
+    bool uses_io_uring() const { return have_ring; }
+};
@@ -1,22 +1,34 @@
 #include <cstdlib>
+#include <cstdio>
+#include <cstdint>
+#include <climits>
+#include <cmath>
 #include <iostream>
 #include <string>
+#include <sstream>
+#include <vector>
 #include <filesystem>
 #include <fstream>
-#include <cstdio>
-#include <memory>
-#include <array>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "MergeSort.hpp"
+#include "QuickSort.hpp"
+#include "adaptive_sort.hpp"
 
 namespace fs = std::filesystem;
 
 /**
  * Permite imprimir simultáneamente en la consola estándar (`std::cout`) y en un archivo.
- * 
+ *
  * Constructor:
  *   TeeStream(std::ostream& c, const std::string& filename)
  *     - c: flujo de salida de consola (por lo general, std::cout).
  *     - filename: nombre del archivo donde también se escribirá la salida.
- * 
+ *
  * Métodos:
  *   operator<<: Sobrecarga del operador << para enviar datos tanto al flujo de consola como al archivo.
  *     - value: cualquier dato imprimible por ostream.
@@ -44,108 +56,300 @@ public:
     }
 };
 
+// Ejecuciones de calentamiento (no se miden) antes de cada configuración
+const int WARMUP_RUNS = 1;
+// Ejecuciones medidas con el caché de páginas caliente
+const int WARM_REPETITIONS = 5;
+// Ejecuciones medidas tras sacar la entrada del caché de páginas
+const int COLD_REPETITIONS = 3;
+
+// Distribuciones de la entrada
+const std::vector<std::string> DISTRIBUTIONS = {"aleatorio", "ordenado", "inverso", "duplicados", "casi_ordenado", "runs"};
+
+// Runs ascendentes de la distribución "runs": más que los descriptores de archivo que un
+// proceso suele tener abiertos (1024), para cubrir la mezcla natural con muchos tramos
+const int64_t NATURAL_RUNS = 2000;
+
+// Algoritmos comparados
+const std::vector<std::string> ALGORITHMS = {"mergesort", "quicksort", "adaptativo"};
+
 /**
- * Ejecuta un comando del sistema, redirige su salida (stdout y stderr) a un archivo temporal
- * y luego imprime su contenido a través de un objeto TeeStream. Al utilizar Docker, se debio
- * cambiar la forma en la que se guardaba la salida al archivo, por lo que el archivo queda vacio.
- * 
- * Parámetros:
- *   - cmd: comando del sistema a ejecutar.
- *   - out: objeto TeeStream para imprimir salida simultáneamente en consola y archivo.
- * 
- * Retorno:
- *   - true si el comando se ejecutó correctamente (código de retorno 0).
- *   - false si hubo un error al ejecutar el comando.
+ * Genera un archivo de entrada de N enteros de 64 bits con la distribución pedida.
+ *
+ * @param filename Nombre del archivo a generar.
+ * @param N Cantidad de elementos.
+ * @param distribution "aleatorio" (permutación de 0..N-1 por bloques de 10 MB, como
+ *                     generatorBlock), "ordenado", "inverso", "duplicados" (100 claves
+ *                     distintas), "casi_ordenado" (ordenado con 1% de intercambios) o "runs"
+ *                     (NATURAL_RUNS runs ascendentes seguidos con claves intercaladas).
+ * @param seed Semilla del generador, para que las repeticiones usen la misma entrada.
+ */
+void generate_input(const std::string& filename, int64_t N, const std::string& distribution, uint64_t seed) {
+    const int64_t CHUNK = 10 * 1024 * 1024 / ELEMENT_SIZE;
+    FILE* out = fopen(filename.c_str(), "wb");
+    if (!out) {
+        fprintf(stderr, "[ERROR] No se pudo crear %s\n", filename.c_str());
+        exit(1);
+    }
+
+    std::mt19937_64 rng(seed);
+    std::vector<int64_t> block(CHUNK);
+    for (int64_t written = 0; written < N; written += CHUNK) {
+        int64_t count = std::min(CHUNK, N - written);
+        for (int64_t i = 0; i < count; i++) {
+            int64_t pos = written + i;
+            if (distribution == "inverso") block[i] = N - pos;
+            else if (distribution == "duplicados") block[i] = rng() % 100;
+            else if (distribution == "runs") block[i] = pos % ((N + NATURAL_RUNS - 1) / NATURAL_RUNS) * NATURAL_RUNS + pos / ((N + NATURAL_RUNS - 1) / NATURAL_RUNS);
+            else block[i] = pos;
+        }
+        if (distribution == "aleatorio") {
+            std::shuffle(block.begin(), block.begin() + count, rng);
+        } else if (distribution == "casi_ordenado") {
+            for (int64_t s = 0; s < count / 100; s++) std::swap(block[rng() % count], block[rng() % count]);
+        }
+        fwrite(block.data(), ELEMENT_SIZE, count, out);
+    }
+    fclose(out);
+}
+
+/**
+ * Saca un archivo del caché de páginas del sistema, para medir una ejecución en frío.
+ */
+void drop_file_cache(const std::string& filename) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+}
+
+/**
+ * Verifica que un archivo de enteros de 64 bits tenga N elementos en orden creciente.
  */
-bool run_command(const std::string& cmd, TeeStream& out) {
-    std::string temp_file = "experimentacion.txt";
-    std::string full_cmd = cmd + " > " + temp_file + " 2>&1"; // Redirect stdout and stderr
+bool is_sorted_file(const std::string& filename, int64_t N) {
+    FILE* f = fopen(filename.c_str(), "rb");
+    if (!f) return false;
+    std::vector<int64_t> buf(1 << 16);
+    int64_t count = 0, prev = INT64_MIN;
+    bool sorted = true;
+    size_t n;
+    while (sorted && (n = fread(buf.data(), ELEMENT_SIZE, buf.size(), f)) > 0) {
+        for (size_t i = 0; i < n; i++) {
+            if (buf[i] < prev) sorted = false;
+            prev = buf[i];
+        }
+        count += n;
+    }
+    fclose(f);
+    return sorted && count == N;
+}
 
-    out << "Ejecutando: " << cmd << std::endl;
+// Una configuración del barrido
+struct BenchmarkConfig {
+    std::string algorithm;
+    std::string distribution;
+    int64_t n_bytes;
+    int64_t m_bytes;
+    int64_t arity;  // 0: ajuste automático (ver autotune.hpp)
+};
+
+// Resultado de una configuración con el caché caliente o frío
+struct BenchmarkResult {
+    BenchmarkConfig config;
+    std::string cache;
+    std::vector<double> seconds;
+    int64_t arity = 0;
+    long reads = 0, writes = 0;
+    bool sorted = true;
+    std::string phases = "null";  // Reporte de métricas por fase de la última ejecución
+
+    // Percentil p (entre 0 y 1) de los tiempos, por rango más cercano
+    double percentile(double p) const {
+        std::vector<double> s = seconds;
+        std::sort(s.begin(), s.end());
+        size_t rank = (size_t)std::max(1.0, std::ceil(p * s.size()));
+        return s[std::min(rank, s.size()) - 1];
+    }
 
-    int ret = std::system(full_cmd.c_str());
-    std::ifstream in(temp_file);
-    std::string line;
-    while (std::getline(in, line)) {
-        out << line << '\n';
+    double throughput_mb_s() const {
+        return config.n_bytes / (1024.0 * 1024.0) / percentile(0.5);
     }
-    in.close();
-    std::remove(temp_file.c_str());
+};
 
-    if (ret != 0) {
-        out << "Error al ejecutar: " << cmd << std::endl;
-        return false;
+/**
+ * Ordena la entrada una vez con la configuración dada, dentro del mismo proceso.
+ *
+ * @param config Configuración a ejecutar.
+ * @param input_file Archivo de entrada.
+ * @param output_file Archivo de salida (se sobrescribe).
+ * @param result Resultado donde se acumulan el tiempo, las I/Os y la verificación.
+ */
+void run_once(const BenchmarkConfig& config, const std::string& input_file, const std::string& output_file,
+              BenchmarkResult& result) {
+    int64_t N = config.n_bytes / ELEMENT_SIZE;
+    int64_t M = config.m_bytes / ELEMENT_SIZE;
+    int64_t a = config.arity;
+    merge_buffer_blocks = 1;
+    if (config.algorithm == "mergesort" && a == 0) {
+        MergeTuning tuning = tune_mergesort(N, M, RunFormation::REPLACEMENT_SELECTION, device_profile_for(input_file));
+        a = tuning.arity;
+        merge_buffer_blocks = tuning.buffer_blocks;
+    } else if (config.algorithm == "quicksort" && a == 0) {
+        a = tune_quicksort_arity(N, M, device_profile_for(input_file));
     }
 
-    return true;
+    metrics.reset();
+    auto start = std::chrono::steady_clock::now();
+    if (config.algorithm == "mergesort") mergesort_external(input_file, output_file, N, M, a);
+    else if (config.algorithm == "quicksort") quicksort_external(input_file, output_file, a, N, M);
+    else adaptive_sort(input_file, output_file, N, M, a);  // Con a = 0 ajusta la aridad del algoritmo que elija
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    result.seconds.push_back(elapsed);
+    result.arity = a;
+    result.reads = read_io;
+    result.writes = write_io;
+    result.phases = metrics.to_json();
+    result.sorted = result.sorted && is_sorted_file(output_file, N);
+    fs::remove(output_file);
 }
 
 /**
- * Ejecuta una batería de pruebas automatizadas de ordenamiento externo.
- * Para diferentes tamaños de entrada, se realizan pruebas con los algoritmos MergeSort y QuickSort,
- * verificando la validez del resultado con un programa `check`, y registrando toda la salida
- * en el archivo `experimentacion.txt`.
- * 
- * Proceso:
- *   - Por cada tamaño de entrada (200MB, 400MB, ..., 800MB):
- *       - Se generan datos de prueba con `generate`.
- *       - Se ordenan con `MergeSort`.
- *       - Se valida el resultado con `check`.
- *       - Se repite el proceso usando `QuickSort`.
- * 
- * Parámetros:
- *   - Ninguno (rutas y parámetros están codificados en el cuerpo).
- * 
- * Retorno:
- *   - 0 si la simulación se ejecuta correctamente.
+ * Separa una lista de valores separados por comas.
  */
-int main() {
-    const size_t MB = 1024 * 1024;
-    const size_t A = 96;
-    const std::string input_file = "/tmp/input.bin";
-    const std::string output_file = "/tmp/output.bin";
-
-    TeeStream out(std::cout, "experimentacion.txt");
+std::vector<std::string> split_list(const std::string& list) {
+    std::vector<std::string> items;
+    std::stringstream ss(list);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) items.push_back(item);
+    }
+    return items;
+}
 
-    for (int m = 4; m <= 16; m += 4) {
-        size_t N_in_bytes = m * 50 * MB;
-        size_t N = m * 50 * MB / sizeof(int64_t);
-        out << "\n==== Tamaño: " << m * 50 << " MB ====\n";
+/**
+ * Escribe los resultados en CSV y en JSON.
+ */
+void write_results(const std::vector<BenchmarkResult>& results, const std::string& prefix) {
+    FILE* csv = fopen((prefix + ".csv").c_str(), "w");
+    FILE* json = fopen((prefix + ".json").c_str(), "w");
+    if (!csv || !json) {
+        fprintf(stderr, "[ERROR] No se pudieron escribir los resultados %s.csv / %s.json\n", prefix.c_str(), prefix.c_str());
+        exit(1);
+    }
 
-        for (int trial = 1; trial <= 5; ++trial) {
-            out << "\n-- Prueba #" << trial << " con N = " << N_in_bytes << " B --\n";
+    fprintf(csv, "algoritmo,distribucion,N_bytes,M_bytes,aridad,cache,repeticiones,mediana_s,p95_s,mb_s,lecturas,escrituras,ordenado\n");
+    fprintf(json, "[\n");
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchmarkResult& r = results[i];
+        const BenchmarkConfig& c = r.config;
+        fprintf(csv, "%s,%s,%ld,%ld,%ld,%s,%zu,%.6f,%.6f,%.2f,%ld,%ld,%d\n",
+                c.algorithm.c_str(), c.distribution.c_str(), c.n_bytes, c.m_bytes, r.arity, r.cache.c_str(),
+                r.seconds.size(), r.percentile(0.5), r.percentile(0.95), r.throughput_mb_s(), r.reads, r.writes, r.sorted);
+        fprintf(json,
+                "  {\"algoritmo\": \"%s\", \"distribucion\": \"%s\", \"N_bytes\": %ld, \"M_bytes\": %ld, "
+                "\"aridad\": %ld, \"aridad_automatica\": %s, \"cache\": \"%s\", \"repeticiones\": %zu, "
+                "\"mediana_s\": %.6f, \"p95_s\": %.6f, \"mb_s\": %.2f, \"lecturas\": %ld, \"escrituras\": %ld, "
+                "\"ordenado\": %s, \"metricas\": %s}%s\n",
+                c.algorithm.c_str(), c.distribution.c_str(), c.n_bytes, c.m_bytes, r.arity, c.arity == 0 ? "true" : "false",
+                r.cache.c_str(), r.seconds.size(), r.percentile(0.5), r.percentile(0.95), r.throughput_mb_s(),
+                r.reads, r.writes, r.sorted ? "true" : "false", r.phases.c_str(), i + 1 < results.size() ? "," : "");
+    }
+    fprintf(json, "]\n");
+    fclose(csv);
+    fclose(json);
+}
 
-            out << ">> generate.exe " << N << "\n";
-            if (!run_command("./generate " + input_file + " " + std::to_string(N_in_bytes), out))
-                 continue;
+/**
+ * Ejecuta una batería de mediciones de ordenamiento externo dentro del mismo proceso.
+ *
+ * Recorre todas las combinaciones de tamaño de entrada, memoria, aridad, algoritmo y
+ * distribución. Para cada una genera la entrada, hace WARMUP_RUNS ejecuciones sin medir
+ * y luego WARM_REPETITIONS con el caché caliente y COLD_REPETITIONS sacando la entrada
+ * del caché antes de cada una. Verifica que cada salida quede ordenada y registra la
+ * mediana, el percentil 95, el rendimiento en MB/s (sobre la mediana) y las I/Os; el
+ * JSON incluye además las métricas por fase (ver metrics.hpp) de la última ejecución.
+ *
+ * Parámetros:
+ * @param argc Número de argumentos.
+ * @param argv Lista de argumentos, todos opcionales. Se espera:
+ * * argv[1]: prefijo de los archivos de resultados (por defecto "resultados", que
+ *            genera resultados.csv y resultados.json)
+ * * argv[2]: directorio de archivos temporales (por defecto /tmp)
+ * * argv[3]: tamaños de entrada en MB separados por comas (por defecto 200,400,600,800)
+ * * argv[4]: memorias M en MB separadas por comas (por defecto 50)
+ * * argv[5]: aridades separadas por comas; "auto" usa el ajuste automático (por defecto auto)
+ * * argv[6]: distribuciones separadas por comas (por defecto aleatorio); ver DISTRIBUTIONS
+ *
+ * La bitácora de la ejecución se imprime en consola y en `experimentacion.txt`.
+ *
+ * @return 0 si todas las salidas quedaron ordenadas, 1 si no o si hubo error de uso.
+ */
+int main(int argc, char* argv[]) {
+    const int64_t MB = 1024 * 1024;
+    std::string prefix = argc > 1 ? argv[1] : "resultados";
+    std::string scratch_dir = argc > 2 ? argv[2] : "/tmp";
+    std::vector<std::string> sizes = split_list(argc > 3 ? argv[3] : "200,400,600,800");
+    std::vector<std::string> memories = split_list(argc > 4 ? argv[4] : "50");
+    std::vector<std::string> arities = split_list(argc > 5 ? argv[5] : "auto");
+    std::vector<std::string> distributions = split_list(argc > 6 ? argv[6] : "aleatorio");
+    for (const auto& d : distributions) {
+        if (std::find(DISTRIBUTIONS.begin(), DISTRIBUTIONS.end(), d) == DISTRIBUTIONS.end()) {
+            fprintf(stderr, "[ERROR] Distribución desconocida: %s\n", d.c_str());
+            return 1;
+        }
+    }
 
-            out << "-> MergeSort\n";
-            if (!run_command("./MergeSort " + input_file + " " + output_file + " " + std::to_string(N_in_bytes) + " " + std::to_string(50*MB) + " " + std::to_string(A), out))
-                continue;
+    const std::string input_file = scratch_dir + "/input.bin";
+    const std::string output_file = scratch_dir + "/output.bin";
 
-            out << ">> check.exe " << output_file << "\n";
-            if (!run_command("./check " + output_file, out))
-                continue;
+    TeeStream out(std::cout, "experimentacion.txt");
+    std::vector<BenchmarkResult> results;
+    bool all_sorted = true;
 
-            out << ">> Borrar " << output_file << "\n";
-            fs::remove(output_file);
+    for (const auto& size : sizes) {
+        int64_t n_bytes = std::stoll(size) * MB;
+        for (const auto& distribution : distributions) {
+            out << "\n==== Tamaño: " << size << " MB, distribución: " << distribution << " ====\n";
+            generate_input(input_file, n_bytes / ELEMENT_SIZE, distribution, 12345);
 
-            out << "-> QuickSort\n";
-            if (!run_command("./QuickSort " + input_file + " " + output_file + " " + std::to_string(A) + " " + std::to_string(N_in_bytes), out))
-                continue;
+            for (const auto& memory : memories) {
+                for (const auto& arity : arities) {
+                    for (const auto& algorithm : ALGORITHMS) {
+                        BenchmarkConfig config = {algorithm, distribution, n_bytes, std::stoll(memory) * MB,
+                                                  arity == "auto" ? 0 : std::stoll(arity)};
+                        out << "-> " << algorithm << " M = " << memory << " MB, a = " << arity << "\n";
 
-            out << ">> check.exe " << output_file << "\n";
-            if (!run_command("./check " + output_file, out))
-                continue;
+                        BenchmarkResult warmup;
+                        for (int i = 0; i < WARMUP_RUNS; i++) run_once(config, input_file, output_file, warmup);
 
-            out << ">> Borrar " << output_file << "\n";
-            fs::remove(output_file);
+                        BenchmarkResult warm, cold;
+                        warm.config = cold.config = config;
+                        warm.cache = "caliente";
+                        cold.cache = "frio";
+                        for (int i = 0; i < WARM_REPETITIONS; i++) run_once(config, input_file, output_file, warm);
+                        for (int i = 0; i < COLD_REPETITIONS; i++) {
+                            drop_file_cache(input_file);
+                            run_once(config, input_file, output_file, cold);
+                        }
 
-            out << ">> Borrar " << input_file << "\n";
+                        for (const BenchmarkResult* r : {&warm, &cold}) {
+                            out << "   " << r->cache << ": mediana " << r->percentile(0.5) << " s, p95 "
+                                << r->percentile(0.95) << " s, " << r->throughput_mb_s() << " MB/s, aridad "
+                                << r->arity << ", I/Os " << r->reads + r->writes << " (lecturas: " << r->reads
+                                << ", escrituras: " << r->writes << ")" << (r->sorted ? "" : ", NO ORDENADO") << "\n";
+                            all_sorted = all_sorted && r->sorted;
+                            results.push_back(*r);
+                        }
+                        write_results(results, prefix);
+                    }
+                }
+            }
             fs::remove(input_file);
         }
     }
 
-    out << "\nSimulación completada.\n";
-    return 0;
+    out << "\nSimulación completada. Resultados en " << prefix << ".csv y " << prefix << ".json\n";
+    return all_sorted ? 0 : 1;
 }
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <algorithm>
+#include <sys/resource.h>
+
+/**
+ * Región única de memoria, de tamaño fijo, de la que salen todos los buffers de datos
+ * del ordenamiento (espacio para ordenar, buffers de runs y de salida).
+ *
+ * Se reserva una sola vez con el tamaño del presupuesto M y se reparte como una pila:
+ * `allocate` entrega el siguiente tramo libre y `release(marca)` devuelve todo lo
+ * entregado después de `mark()`. Pedir más de lo que queda termina el programa con un
+ * error, así que ninguna fase puede exceder el presupuesto sin que se note. La región
+ * está alineada a 4 KB, de modo que los tramos de bloques completos sirven como buffers
+ * de E/S directa (O_DIRECT).
+ *
+ * Métodos:
+ *   init(elements): reserva el presupuesto (no hace nada si ya tiene ese tamaño).
+ *   allocate(n): entrega n elementos contiguos.
+ *   mark() / release(m): guarda y restaura el tope de la pila.
+ *   available(): elementos libres.
+ *   capacity(): tamaño total del presupuesto.
+ *   peak(): máximo de elementos entregados a la vez desde init.
+ */
+class MemoryArena {
+    struct AlignedFree {
+        void operator()(int64_t* p) const { free(p); }
+    };
+
+    std::unique_ptr<int64_t[], AlignedFree> base;
+    size_t total = 0, used = 0, max_used = 0;
+
+public:
+    void init(size_t elements) {
+        if (base && total == elements) return;
+        if (used > 0) {
+            fprintf(stderr, "[ERROR] No se puede redimensionar la memoria en uso\n");
+            exit(1);
+        }
+        base.reset();
+        size_t bytes = (std::max<size_t>(elements, 1) * sizeof(int64_t) + 4095) / 4096 * 4096;
+        base.reset((int64_t*)aligned_alloc(4096, bytes));
+        if (!base) {
+            fprintf(stderr, "[ERROR] No se pudieron reservar %zu bytes de memoria\n", bytes);
+            exit(1);
+        }
+        total = elements;
+        max_used = 0;
+    }
+
+    int64_t* allocate(size_t n) {
+        if (n > total - used) {
+            fprintf(stderr, "[ERROR] Memoria insuficiente: se piden %zu elementos y quedan %zu de %zu\n",
+                    n, total - used, total);
+            exit(1);
+        }
+        int64_t* ptr = base.get() + used;
+        used += n;
+        max_used = std::max(max_used, used);
+        return ptr;
+    }
+
+    size_t mark() const { return used; }
+    void release(size_t m) { used = m; }
+    size_t available() const { return total - used; }
+    size_t capacity() const { return total; }
+    size_t peak() const { return max_used; }
+};
+
+// Memoria compartida por todas las fases del ordenamiento
+inline MemoryArena memory_arena;
+
+/**
+ * Devuelve a `memory_arena`, al salir del alcance, todo lo reservado desde su creación.
+ */
+class ArenaScope {
+    size_t saved;
+
+public:
+    ArenaScope() : saved(memory_arena.mark()) {}
+    ~ArenaScope() { memory_arena.release(saved); }
+    ArenaScope(const ArenaScope&) = delete;
+    ArenaScope& operator=(const ArenaScope&) = delete;
+};
+
+/**
+ * Retorna el máximo de memoria residente (RSS) que ha usado el proceso, en bytes.
+ */
+inline long peak_rss_bytes() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss * 1024L;
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <string>
+
+#include "parallel_sort.hpp"
+
+// Bits por dígito del radix sort: 6 pasadas cubren los 64 bits de la clave
+const int RADIX_BITS = 11;
+const size_t RADIX_BUCKETS = size_t(1) << RADIX_BITS;
+const int RADIX_PASSES = (64 + RADIX_BITS - 1) / RADIX_BITS;
+
+// Tamaño bajo el cual std::sort le gana al radix sort
+const size_t RADIX_SORT_MIN = 1 << 12;
+
+/**
+ * Ordena un arreglo de enteros de 64 bits con radix sort LSD.
+ *
+ * @param data Arreglo a ordenar.
+ * @param n Cantidad de elementos.
+ * @param scratch Arreglo auxiliar de al menos n elementos.
+ *
+ * Usa dígitos de 11 bits sobre la clave con el bit de signo invertido, para que los
+ * negativos queden antes que los positivos. Los histogramas de todos los dígitos se
+ * calculan en una sola lectura del arreglo, y se omiten las pasadas en que todas las
+ * claves tienen el mismo dígito (comunes cuando las claves usan pocos bits). Cada
+ * pasada reparte entre `data` y `scratch`, alternando; si el resultado queda en
+ * `scratch` se copia de vuelta al final.
+ */
+inline void radix_sort(int64_t* data, size_t n, int64_t* scratch) {
+    const uint64_t SIGN = uint64_t(1) << 63;
+    std::vector<size_t> counts(RADIX_PASSES * RADIX_BUCKETS, 0);
+    for (size_t i = 0; i < n; i++) {
+        uint64_t key = uint64_t(data[i]) ^ SIGN;
+        for (int d = 0; d < RADIX_PASSES; d++) {
+            counts[d * RADIX_BUCKETS + ((key >> (d * RADIX_BITS)) & (RADIX_BUCKETS - 1))]++;
+        }
+    }
+
+    int64_t* src = data;
+    int64_t* dst = scratch;
+    for (int d = 0; d < RADIX_PASSES; d++) {
+        size_t* count = &counts[d * RADIX_BUCKETS];
+        int shift = d * RADIX_BITS;
+        if (count[((uint64_t(src[0]) ^ SIGN) >> shift) & (RADIX_BUCKETS - 1)] == n) continue;
+
+        size_t offset = 0;
+        for (size_t b = 0; b < RADIX_BUCKETS; b++) {
+            size_t c = count[b];
+            count[b] = offset;
+            offset += c;
+        }
+        for (size_t i = 0; i < n; i++) {
+            uint64_t key = uint64_t(src[i]) ^ SIGN;
+            dst[count[(key >> shift) & (RADIX_BUCKETS - 1)]++] = src[i];
+        }
+        std::swap(src, dst);
+    }
+
+    if (src != data) memcpy(data, src, n * sizeof(int64_t));
+}
+
+// Algoritmos disponibles para ordenar en memoria
+enum class SortBackend {
+    STD_SORT,        // std::sort secuencial
+    PARALLEL_MERGE,  // Mergesort paralelo (parallel_sort)
+    RADIX            // Radix sort LSD (radix_sort)
+};
+
+// Algoritmo usado por memory_sort
+inline SortBackend sort_backend = SortBackend::PARALLEL_MERGE;
+
+/**
+ * Interpreta el nombre de un algoritmo de ordenamiento en memoria ("std", "merge" o "radix").
+ *
+ * @return true si el nombre es válido, dejando el algoritmo en `backend`.
+ */
+inline bool parse_sort_backend(const std::string& name, SortBackend& backend) {
+    if (name == "std") backend = SortBackend::STD_SORT;
+    else if (name == "merge") backend = SortBackend::PARALLEL_MERGE;
+    else if (name == "radix") backend = SortBackend::RADIX;
+    else return false;
+    return true;
+}
+
+/**
+ * Indica si `memory_sort` aprovecharía un arreglo auxiliar para ordenar n elementos con
+ * el algoritmo y la cantidad de hilos configurados, para que el que llama lo reserve
+ * solo cuando sirve.
+ */
+inline bool memory_sort_uses_scratch(size_t n) {
+    switch (sort_backend) {
+        case SortBackend::RADIX: return n >= RADIX_SORT_MIN;
+        case SortBackend::PARALLEL_MERGE: return sort_threads > 1 && n >= PARALLEL_SORT_MIN;
+        default: return false;
+    }
+}
+
+/**
+ * Ordena un arreglo en memoria con el algoritmo elegido en `sort_backend`.
+ *
+ * @param data Arreglo a ordenar.
+ * @param n Cantidad de elementos.
+ * @param scratch Arreglo auxiliar de al menos n elementos, o nullptr si no hay
+ *                memoria para él; en ese caso se usa std::sort.
+ */
+inline void memory_sort(int64_t* data, size_t n, int64_t* scratch) {
+    if (!scratch || !memory_sort_uses_scratch(n)) {
+        std::sort(data, data + n);
+    } else if (sort_backend == SortBackend::RADIX) {
+        radix_sort(data, n, scratch);
+    } else {
+        parallel_sort(data, n, scratch);
+    }
+}
@@ -0,0 +1,218 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <chrono>
+#include <mutex>
+
+#include "sort_common.hpp"
+
+// Métricas de una fase del ordenamiento en una profundidad, sumadas sobre todas sus ejecuciones
+struct PhaseMetrics {
+    std::string name;
+    int depth = 0;
+    long calls = 0;
+    double seconds = 0;                        // Tiempo de pared, sin contar fases anidadas
+    double io_wait_seconds = 0;                // Tiempo bloqueado en E/S, sumado sobre los hilos de cómputo
+    long blocks_read = 0, blocks_written = 0;  // Bloques lógicos (read_io / write_io)
+    long bytes_read = 0, bytes_written = 0;    // Bytes transferidos realmente
+    long read_calls = 0, write_calls = 0;      // Llamadas de lectura y escritura
+};
+
+// Indica que el hilo actual es un hilo de E/S en segundo plano: el tiempo que pasa en
+// E/S no bloquea al cómputo, así que no se cuenta como espera
+inline thread_local bool io_worker_thread = false;
+
+/**
+ * Registro de métricas por fase (formación de runs, distribución, mezcla, ...) y por
+ * profundidad de recursión o número de pasada.
+ *
+ * Las fases se abren y cierran con `PhaseTimer` desde el hilo principal y pueden
+ * anidarse; cada fase cuenta solo lo que no hicieron sus fases anidadas. Las lecturas,
+ * escrituras y esperas se cargan a la fase abierta más interna, desde cualquier hilo.
+ *
+ * Métodos:
+ *   reset(): descarta todo lo registrado.
+ *   record_read(bytes, seconds) / record_write(bytes, seconds): registran una llamada de E/S.
+ *   record_wait(seconds): registra tiempo bloqueado esperando al hilo de E/S.
+ *   to_json(): reporte de todas las fases y del total, en JSON.
+ *   write_json(path): escribe el reporte en un archivo.
+ */
+class Metrics {
+    struct Frame {
+        size_t index;
+        double child_seconds = 0;
+        long child_reads = 0, child_writes = 0;
+    };
+
+    std::mutex mtx;
+    std::vector<PhaseMetrics> phases;
+    std::vector<Frame> stack;
+    PhaseMetrics outside{"fuera_de_fase"};
+
+    PhaseMetrics& current() { return stack.empty() ? outside : phases[stack.back().index]; }
+
+    friend class PhaseTimer;
+
+    void open_phase(const std::string& name, int depth) {
+        std::lock_guard<std::mutex> lock(mtx);
+        size_t index = 0;
+        while (index < phases.size() && (phases[index].name != name || phases[index].depth != depth)) index++;
+        if (index == phases.size()) {
+            phases.push_back(PhaseMetrics());
+            phases.back().name = name;
+            phases.back().depth = depth;
+        }
+        phases[index].calls++;
+        stack.push_back({index});
+    }
+
+    void close_phase(double seconds, long reads, long writes) {
+        std::lock_guard<std::mutex> lock(mtx);
+        Frame frame = stack.back();
+        stack.pop_back();
+        PhaseMetrics& phase = phases[frame.index];
+        phase.seconds += seconds - frame.child_seconds;
+        phase.blocks_read += reads - frame.child_reads;
+        phase.blocks_written += writes - frame.child_writes;
+        if (!stack.empty()) {
+            stack.back().child_seconds += seconds;
+            stack.back().child_reads += reads;
+            stack.back().child_writes += writes;
+        }
+    }
+
+    static void append_json(std::string& out, const PhaseMetrics& p) {
+        char buf[768];
+        snprintf(buf, sizeof(buf),
+                 "{\"fase\": \"%s\", \"profundidad\": %d, \"llamadas\": %ld, \"segundos\": %.6f, "
+                 "\"espera_io_s\": %.6f, \"cpu_s\": %.6f, \"bloques_leidos\": %ld, \"bloques_escritos\": %ld, "
+                 "\"bytes_leidos\": %ld, \"bytes_escritos\": %ld, \"llamadas_lectura\": %ld, \"llamadas_escritura\": %ld}",
+                 p.name.c_str(), p.depth, p.calls, p.seconds, p.io_wait_seconds,
+                 p.seconds > p.io_wait_seconds ? p.seconds - p.io_wait_seconds : 0.0, p.blocks_read, p.blocks_written,
+                 p.bytes_read, p.bytes_written, p.read_calls, p.write_calls);
+        out += buf;
+    }
+
+public:
+    void reset() {
+        std::lock_guard<std::mutex> lock(mtx);
+        phases.clear();
+        stack.clear();
+        outside = PhaseMetrics{"fuera_de_fase"};
+    }
+
+    void record_read(long bytes, double seconds) {
+        std::lock_guard<std::mutex> lock(mtx);
+        PhaseMetrics& p = current();
+        p.read_calls++;
+        p.bytes_read += bytes > 0 ? bytes : 0;
+        p.io_wait_seconds += seconds;
+    }
+
+    void record_write(long bytes, double seconds) {
+        std::lock_guard<std::mutex> lock(mtx);
+        PhaseMetrics& p = current();
+        p.write_calls++;
+        p.bytes_written += bytes > 0 ? bytes : 0;
+        p.io_wait_seconds += seconds;
+    }
+
+    void record_wait(double seconds) {
+        std::lock_guard<std::mutex> lock(mtx);
+        current().io_wait_seconds += seconds;
+    }
+
+    std::string to_json() {
+        std::lock_guard<std::mutex> lock(mtx);
+        PhaseMetrics total{"total"};
+        std::vector<const PhaseMetrics*> all;
+        for (const auto& p : phases) all.push_back(&p);
+        if (outside.read_calls + outside.write_calls > 0 || outside.io_wait_seconds > 0) all.push_back(&outside);
+
+        std::string out = "{\"fases\": [";
+        for (size_t i = 0; i < all.size(); i++) {
+            const PhaseMetrics& p = *all[i];
+            if (i > 0) out += ", ";
+            append_json(out, p);
+            total.calls += p.calls;
+            total.seconds += p.seconds;
+            total.io_wait_seconds += p.io_wait_seconds;
+            total.blocks_read += p.blocks_read;
+            total.blocks_written += p.blocks_written;
+            total.bytes_read += p.bytes_read;
+            total.bytes_written += p.bytes_written;
+            total.read_calls += p.read_calls;
+            total.write_calls += p.write_calls;
+        }
+        out += "], \"total\": ";
+        append_json(out, total);
+        out += "}";
+        return out;
+    }
+
+    bool write_json(const std::string& path) {
+        FILE* f = fopen(path.c_str(), "w");
+        if (!f) {
+            fprintf(stderr, "[ERROR] No se pudo escribir el reporte %s\n", path.c_str());
+            return false;
+        }
+        fprintf(f, "%s\n", to_json().c_str());
+        fclose(f);
+        return true;
+    }
+};
+
+// Métricas del proceso
+inline Metrics metrics;
+
+/**
+ * Mide una fase mientras está en alcance: al salir carga a `metrics` su tiempo de pared
+ * y los bloques lógicos (read_io / write_io) que se contaron durante ella.
+ *
+ * Constructor:
+ *   PhaseTimer(name, depth): abre la fase `name` en la profundidad `depth`.
+ *
+ * Métodos:
+ *   stop(): cierra la fase antes de salir del alcance.
+ */
+class PhaseTimer {
+    std::chrono::steady_clock::time_point start;
+    long reads0, writes0;
+    bool running = true;
+
+public:
+    explicit PhaseTimer(const std::string& name, int depth = 0)
+        : start(std::chrono::steady_clock::now()), reads0(read_io), writes0(write_io) {
+        metrics.open_phase(name, depth);
+    }
+
+    ~PhaseTimer() { stop(); }
+
+    void stop() {
+        if (!running) return;
+        running = false;
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        metrics.close_phase(seconds, read_io - reads0, write_io - writes0);
+    }
+
+    PhaseTimer(const PhaseTimer&) = delete;
+    PhaseTimer& operator=(const PhaseTimer&) = delete;
+};
+
+/**
+ * Ejecuta una operación de E/S y la registra en `metrics` con los bytes que retorna y,
+ * si el hilo actual no es de E/S, el tiempo que estuvo bloqueado en ella.
+ */
+template <typename Op>
+inline auto timed_io(bool is_write, Op op, long bytes_per_unit = 1) {
+    auto start = std::chrono::steady_clock::now();
+    auto result = op();
+    double seconds = io_worker_thread ? 0.0 : std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    long bytes = (long)result * bytes_per_unit;
+    if (is_write) metrics.record_write(bytes, seconds);
+    else metrics.record_read(bytes, seconds);
+    return result;
+}
@@ -0,0 +1,280 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+#include "sort_common.hpp"
+#include "block_device.hpp"
+#include "scratch_space.hpp"
+
+// Formato de los runs intermedios de MergeSort: enteros de 8 bytes, o páginas comprimidas
+inline bool compress_runs = false;
+
+// Bytes en disco y bytes sin comprimir de los runs comprimidos escritos, para el reporte
+inline std::atomic<int64_t> packed_run_bytes{0}, packed_run_logical_bytes{0};
+
+// Encabezado de una página: primer valor (8 bytes), cantidad de valores y bits por diferencia (4 + 4)
+const int64_t PACKED_HEADER_BYTES = 16;
+
+// Bits disponibles para las diferencias en una página
+const int64_t PACKED_PAYLOAD_BITS = (BLOCK_SIZE - PACKED_HEADER_BYTES) * 8;
+
+// Máximo de valores por página (acota el buffer del escritor cuando las diferencias son 0)
+const uint32_t PACKED_MAX_VALUES = 8192;
+
+// Marca al final de un run comprimido
+const int64_t PACKED_MAGIC = 0x314e5552504b4353;  // "SCKPRUN1"
+
+/**
+ * Retorna la cantidad de bits necesaria para representar `d`.
+ */
+inline unsigned bit_width(uint64_t d) {
+    return d == 0 ? 0 : 64 - __builtin_clzll(d);
+}
+
+/**
+ * Comprime n valores en una página de BLOCK_SIZE bytes: guarda el primero completo y
+ * las n - 1 diferencias entre consecutivos con el menor ancho fijo de bits que las
+ * contiene (delta + bit-packing). Las diferencias se calculan módulo 2^64, así que
+ * cualquier secuencia se puede representar; en una secuencia ordenada son pequeñas.
+ *
+ * @param values Valores a comprimir; deben caber en la página (ver PackedRunFile::append).
+ * @param n Cantidad de valores.
+ * @param page Página de salida, de BLOCK_SIZE + 16 bytes (los últimos 16 quedan en cero).
+ */
+inline void pack_page(const int64_t* values, uint32_t n, uint8_t* page) {
+    memset(page, 0, BLOCK_SIZE + 16);
+    uint32_t bits = 0;
+    for (uint32_t i = 1; i < n; i++) bits = std::max(bits, bit_width((uint64_t)values[i] - (uint64_t)values[i - 1]));
+    memcpy(page, &values[0], 8);
+    memcpy(page + 8, &n, 4);
+    memcpy(page + 12, &bits, 4);
+    if (bits == 0) return;
+
+    uint8_t* payload = page + PACKED_HEADER_BYTES;
+    for (uint32_t i = 1; i < n; i++) {
+        uint64_t d = (uint64_t)values[i] - (uint64_t)values[i - 1];
+        uint64_t bit = (uint64_t)(i - 1) * bits;
+        unsigned shift = bit % 8;
+        uint64_t word;
+        memcpy(&word, payload + bit / 8, 8);
+        word |= d << shift;
+        memcpy(payload + bit / 8, &word, 8);
+        if (shift + bits > 64) payload[bit / 8 + 8] |= (uint8_t)(d >> (64 - shift));
+    }
+}
+
+/**
+ * Descomprime los valores [from, to) de una página de `pack_page`.
+ *
+ * @param page Página comprimida, seguida de al menos 8 bytes legibles.
+ * @param from Primer valor pedido.
+ * @param to Valor siguiente al último pedido (a lo más la cantidad de la página).
+ * @param out Destino de los to - from valores.
+ *
+ * Primero extrae las diferencias, cada una con una lectura de 8 bytes, un corrimiento y
+ * una máscara, sin saltos que dependan de los datos (el compilador puede vectorizar
+ * ese ciclo), y luego reconstruye los valores con una suma prefija. Para empezar en
+ * `from` hay que sumar las diferencias anteriores, que se descartan.
+ */
+inline void unpack_page(const uint8_t* page, uint32_t from, uint32_t to, int64_t* out) {
+    if (from >= to) return;
+    uint64_t base;
+    uint32_t bits;
+    memcpy(&base, page, 8);
+    memcpy(&bits, page + 12, 4);
+    if (bits == 0) {
+        std::fill(out, out + (to - from), (int64_t)base);
+        return;
+    }
+
+    const uint8_t* payload = page + PACKED_HEADER_BYTES;
+    const uint64_t mask = bits == 64 ? ~0ULL : (1ULL << bits) - 1;
+    auto delta = [&](uint32_t i) {
+        uint64_t bit = (uint64_t)i * bits;
+        unsigned shift = bit % 8;
+        uint64_t word;
+        memcpy(&word, payload + bit / 8, 8);
+        uint64_t d = word >> shift;
+        if (shift + bits > 64) d |= (uint64_t)payload[bit / 8 + 8] << (64 - shift);
+        return d & mask;
+    };
+
+    // Valor `from`: la base más las diferencias anteriores
+    uint64_t acc = base;
+    for (uint32_t i = 0; i < from; i++) acc += delta(i);
+    out[0] = (int64_t)acc;
+
+    uint64_t* d = (uint64_t*)out;
+    for (uint32_t i = from + 1; i < to; i++) d[i - from] = delta(i - 1);
+    for (uint32_t i = 1; i < to - from; i++) d[i] += d[i - 1];
+}
+
+/**
+ * Run de enteros guardado comprimido en páginas de BLOCK_SIZE bytes (`pack_page`),
+ * seguidas de un índice con la posición (en elementos) del primer valor de cada página
+ * y de un pie con la cantidad de páginas, de elementos y una marca.
+ *
+ * Se usa como cualquier BlockFile con posiciones y tamaños sin comprimir, así que la
+ * mezcla, la búsqueda de separadoras y la lectura anticipada no cambian. Al escribir
+ * solo acepta escrituras al final (los runs se escriben en orden); cada página se llena
+ * con tantos valores como quepan. Al leer, un tramo se traduce a las páginas que lo
+ * contienen con el índice, que se carga al abrir; la última página leída se guarda, de
+ * modo que una lectura secuencial lee cada página del disco una sola vez. En `metrics`
+ * se registran las páginas que se leen y escriben, no los bytes sin comprimir.
+ *
+ * Constructor:
+ *   PackedRunFile(file, mode): envuelve un archivo recién creado (CREATE) o un run
+ *     comprimido existente (READ).
+ */
+class PackedRunFile : public BlockFile {
+    std::unique_ptr<BlockFile> file;
+    bool writing;
+    std::mutex mtx;
+    std::vector<int64_t> first_index;  // Posición del primer valor de cada página
+    int64_t total = 0;
+
+    // Escritura: valores de la página en curso
+    std::vector<int64_t> pending;
+    unsigned pending_bits = 0;
+    std::vector<uint8_t> page;
+
+    // Lectura: páginas leídas y la última página, para no volver a leerla
+    std::vector<uint8_t> staging;
+    int64_t cached_page = -1;
+
+    void emit_page() {
+        if (pending.empty()) return;
+        pack_page(pending.data(), pending.size(), page.data());
+        file->write(page.data(), BLOCK_SIZE);
+        first_index.push_back(total);
+        total += pending.size();
+        pending.clear();
+        pending_bits = 0;
+    }
+
+    void append(int64_t value) {
+        if (!pending.empty()) {
+            unsigned bits = std::max(pending_bits, bit_width((uint64_t)value - (uint64_t)pending.back()));
+            if (pending.size() == PACKED_MAX_VALUES || (int64_t)pending.size() * bits > PACKED_PAYLOAD_BITS) {
+                emit_page();
+            } else {
+                pending_bits = bits;
+            }
+        }
+        pending.push_back(value);
+    }
+
+protected:
+    size_t do_read(void* buf, size_t bytes, int64_t offset) override {
+        std::lock_guard<std::mutex> lock(mtx);
+        int64_t e0 = offset / ELEMENT_SIZE;
+        int64_t e1 = std::min<int64_t>(total, (offset + (int64_t)bytes) / ELEMENT_SIZE);
+        if (e0 >= e1) return 0;
+        int64_t p0 = std::upper_bound(first_index.begin(), first_index.end(), e0) - first_index.begin() - 1;
+        int64_t p1 = std::upper_bound(first_index.begin(), first_index.end(), e1 - 1) - first_index.begin() - 1;
+
+        // staging[0] es la página p0; si es la última leída ya está ahí
+        int64_t pages = p1 - p0 + 1;
+        int64_t first_missing = p0;
+        if (cached_page == p0) {
+            first_missing = p0 + 1;
+        } else if (cached_page >= 0) {
+            cached_page = -1;
+        }
+        if ((int64_t)staging.size() < pages * BLOCK_SIZE + 16) {
+            std::vector<uint8_t> grown(pages * BLOCK_SIZE + 16, 0);
+            if (first_missing > p0) memcpy(grown.data(), staging.data(), BLOCK_SIZE);
+            staging.swap(grown);
+        }
+        if (first_missing <= p1) {
+            file->read_at(staging.data() + (first_missing - p0) * BLOCK_SIZE, (p1 - first_missing + 1) * BLOCK_SIZE,
+                          first_missing * BLOCK_SIZE);
+        }
+
+        int64_t* out = (int64_t*)buf;
+        for (int64_t p = p0; p <= p1; p++) {
+            int64_t start = first_index[p];
+            int64_t end = p + 1 < (int64_t)first_index.size() ? first_index[p + 1] : total;
+            uint32_t from = std::max(e0, start) - start, to = std::min(e1, end) - start;
+            unpack_page(staging.data() + (p - p0) * BLOCK_SIZE, from, to, out);
+            out += to - from;
+        }
+        if (p1 > p0) memmove(staging.data(), staging.data() + pages * BLOCK_SIZE - BLOCK_SIZE, BLOCK_SIZE);
+        cached_page = p1;
+        return (e1 - e0) * ELEMENT_SIZE;
+    }
+
+    size_t do_write(const void* buf, size_t bytes, int64_t offset) override {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (!writing || offset != (total + (int64_t)pending.size()) * ELEMENT_SIZE) {
+            fprintf(stderr, "[ERROR] Un run comprimido solo admite escrituras al final\n");
+            exit(1);
+        }
+        const int64_t* values = (const int64_t*)buf;
+        for (size_t i = 0; i < bytes / ELEMENT_SIZE; i++) append(values[i]);
+        return bytes;
+    }
+
+public:
+    PackedRunFile(std::unique_ptr<BlockFile> f, OpenMode mode) : file(std::move(f)), writing(mode == OpenMode::CREATE) {
+        if (writing) {
+            pending.reserve(PACKED_MAX_VALUES);
+            page.resize(BLOCK_SIZE + 16);
+            return;
+        }
+        int64_t size = file->size();
+        int64_t footer[3] = {0, 0, 0};
+        if (size < (int64_t)sizeof(footer) || file->read_at(footer, sizeof(footer), size - sizeof(footer)) != sizeof(footer) ||
+            footer[2] != PACKED_MAGIC) {
+            fprintf(stderr, "[ERROR] El archivo no es un run comprimido\n");
+            exit(1);
+        }
+        first_index.resize(footer[0]);
+        total = footer[1];
+        file->read_at(first_index.data(), footer[0] * sizeof(int64_t), footer[0] * BLOCK_SIZE);
+    }
+
+    ~PackedRunFile() override {
+        if (!writing) return;
+        emit_page();
+        int64_t pages = first_index.size();
+        file->write(first_index.data(), pages * sizeof(int64_t));
+        int64_t footer[3] = {pages, total, PACKED_MAGIC};
+        file->write(footer, sizeof(footer));
+        packed_run_bytes += pages * BLOCK_SIZE + (pages + 3) * (int64_t)sizeof(int64_t);
+        packed_run_logical_bytes += total * ELEMENT_SIZE;
+    }
+
+    int64_t size() override {
+        std::lock_guard<std::mutex> lock(mtx);
+        return (total + pending.size()) * ELEMENT_SIZE;
+    }
+
+    void truncate(int64_t) override {}
+
+    bool layered() const override { return true; }
+
+    const void* io_queue() const override { return file->io_queue(); }
+};
+
+/**
+ * Abre un run intermedio de MergeSort, comprimido si `compress_runs` está activo (los
+ * archivos que no son temporales se leen tal cual). Un run nuevo se crea en un disco
+ * distinto de los runs `away_from`, si el espacio temporal tiene varios.
+ */
+inline std::unique_ptr<BlockFile> open_run(const std::string& name, OpenMode mode,
+                                           const std::vector<std::string>& away_from = {}) {
+    auto f = mode == OpenMode::CREATE ? create_scratch(name, away_from) : scratch_device().open(name, mode);
+    // Los tramos que se leen directamente de la entrada (mezcla natural) no están comprimidos
+    if (!compress_runs || (mode == OpenMode::READ && !is_scratch_file(name))) return f;
+    return std::make_unique<PackedRunFile>(std::move(f), mode);
+}
@@ -0,0 +1,207 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+/**
+ * Conjunto fijo de hilos para repartir trabajo de CPU.
+ *
+ * Constructor:
+ *   ThreadPool(threads): crea threads - 1 hilos trabajadores; el hilo que llama a
+ *   `parallel_for` también trabaja, así que `threads` es el paralelismo total.
+ *
+ * Métodos:
+ *   parallel_for(n, fn): ejecuta fn(0), ..., fn(n - 1) repartidos entre los hilos y
+ *     retorna cuando todas las llamadas terminaron.
+ *   size(): cantidad total de hilos.
+ */
+class ThreadPool {
+    std::vector<std::thread> workers;
+    std::mutex mtx;
+    std::condition_variable cv_job, cv_done;
+    const std::function<void(size_t)>* job = nullptr;
+    size_t job_size = 0;
+    std::atomic<size_t> next_index{0};
+    size_t active = 0;
+    uint64_t generation = 0;
+    bool stopping = false;
+
+    void work(const std::function<void(size_t)>& fn, size_t n) {
+        for (size_t i = next_index++; i < n; i = next_index++) fn(i);
+    }
+
+    void run() {
+        uint64_t seen = 0;
+        while (true) {
+            const std::function<void(size_t)>* fn;
+            size_t n;
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                cv_job.wait(lock, [&] { return stopping || generation != seen; });
+                if (stopping) return;
+                seen = generation;
+                if (!job) continue;
+                fn = job;
+                n = job_size;
+                active++;
+            }
+            work(*fn, n);
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                active--;
+            }
+            cv_done.notify_all();
+        }
+    }
+
+public:
+    explicit ThreadPool(unsigned threads) {
+        for (unsigned i = 1; i < std::max(1u, threads); i++) workers.emplace_back(&ThreadPool::run, this);
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stopping = true;
+        }
+        cv_job.notify_all();
+        for (auto& t : workers) t.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned size() const { return workers.size() + 1; }
+
+    void parallel_for(size_t n, const std::function<void(size_t)>& fn) {
+        if (workers.empty() || n <= 1) {
+            for (size_t i = 0; i < n; i++) fn(i);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            job = &fn;
+            job_size = n;
+            next_index = 0;
+            generation++;
+        }
+        cv_job.notify_all();
+        work(fn, n);
+        std::unique_lock<std::mutex> lock(mtx);
+        cv_done.wait(lock, [&] { return active == 0 && next_index >= n; });
+        job = nullptr;
+    }
+};
+
+// Cantidad de hilos usada por el ordenamiento en memoria (por defecto, todos los núcleos)
+inline unsigned sort_threads = std::max(1u, std::thread::hardware_concurrency());
+
+/**
+ * Retorna el ThreadPool compartido por los ordenamientos en memoria, creándolo (o
+ * recreándolo) si `sort_threads` cambió desde la última llamada.
+ */
+inline ThreadPool& sort_pool() {
+    static std::unique_ptr<ThreadPool> pool;
+    if (!pool || pool->size() != sort_threads) {
+        pool.reset();
+        pool = std::make_unique<ThreadPool>(sort_threads);
+    }
+    return *pool;
+}
+
+/**
+ * Calcula cuántos elementos de A forman parte de los primeros `d` elementos de la
+ * mezcla de A y B (búsqueda binaria sobre la diagonal d del camino de mezcla).
+ *
+ * @param A Primer arreglo ordenado, de largo m.
+ * @param B Segundo arreglo ordenado, de largo l.
+ * @param d Posición en la salida (0 <= d <= m + l).
+ *
+ * @return i tal que A[0, i) y B[0, d - i) son los primeros d elementos de la mezcla.
+ */
+inline size_t merge_path_split(const int64_t* A, size_t m, const int64_t* B, size_t l, size_t d) {
+    size_t lo = d > l ? d - l : 0, hi = std::min(d, m);
+    while (lo < hi) {
+        size_t i = lo + (hi - lo) / 2;
+        if (A[i] < B[d - i - 1]) lo = i + 1;
+        else hi = i;
+    }
+    return lo;
+}
+
+// Tamaño bajo el cual no conviene repartir un ordenamiento entre hilos
+const size_t PARALLEL_SORT_MIN = 1 << 16;
+
+/**
+ * Ordena un arreglo en memoria usando mergesort paralelo.
+ *
+ * @param data Arreglo a ordenar.
+ * @param n Cantidad de elementos.
+ * @param scratch Arreglo auxiliar de al menos n elementos, o nullptr.
+ *
+ * Divide el arreglo en un trozo por hilo y ordena cada trozo con std::sort en paralelo.
+ * Luego mezcla los trozos de a pares, alternando entre `data` y `scratch`; cada mezcla
+ * se corta en tantos tramos independientes como hilos usando el camino de mezcla, así
+ * que todas las rondas usan todos los hilos. Si hay un solo hilo, el arreglo es chico o
+ * no hay arreglo auxiliar, usa std::sort directamente.
+ */
+inline void parallel_sort(int64_t* data, size_t n, int64_t* scratch) {
+    ThreadPool& pool = sort_pool();
+    size_t p = pool.size();
+    if (p == 1 || n < PARALLEL_SORT_MIN || !scratch) {
+        std::sort(data, data + n);
+        return;
+    }
+
+    std::vector<size_t> bounds(p + 1);
+    for (size_t i = 0; i <= p; i++) bounds[i] = n * i / p;
+    pool.parallel_for(p, [&](size_t i) { std::sort(data + bounds[i], data + bounds[i + 1]); });
+
+    struct MergeTask {
+        const int64_t* a; size_t la;
+        const int64_t* b; size_t lb;
+        int64_t* dst;
+    };
+
+    int64_t* src = data;
+    int64_t* dst = scratch;
+    while (bounds.size() > 2) {
+        std::vector<size_t> next_bounds;
+        std::vector<MergeTask> tasks;
+        for (size_t r = 0; r + 1 < bounds.size(); r += 2) {
+            size_t lo = bounds[r], mid = bounds[r + 1];
+            size_t hi = r + 2 < bounds.size() ? bounds[r + 2] : mid;
+            next_bounds.push_back(lo);
+            const int64_t* A = src + lo;
+            const int64_t* B = src + mid;
+            size_t m = mid - lo, l = hi - mid;
+            for (size_t part = 0; part < p; part++) {
+                size_t d0 = (m + l) * part / p, d1 = (m + l) * (part + 1) / p;
+                size_t i0 = merge_path_split(A, m, B, l, d0), i1 = merge_path_split(A, m, B, l, d1);
+                tasks.push_back({A + i0, i1 - i0, B + (d0 - i0), (d1 - i1) - (d0 - i0), dst + lo + d0});
+            }
+        }
+        next_bounds.push_back(n);
+        pool.parallel_for(tasks.size(), [&](size_t t) {
+            const MergeTask& task = tasks[t];
+            std::merge(task.a, task.a + task.la, task.b, task.b + task.lb, task.dst);
+        });
+        bounds = next_bounds;
+        std::swap(src, dst);
+    }
+
+    if (src != data) {
+        pool.parallel_for(p, [&](size_t i) {
+            size_t lo = n * i / p, hi = n * (i + 1) / p;
+            memcpy(data + lo, src + lo, (hi - lo) * sizeof(int64_t));
+        });
+    }
+}
@@ -0,0 +1,340 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <queue>
+#include <memory>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <type_traits>
+
+#include "sort_common.hpp"
+#include "metrics.hpp"
+#include "block_device.hpp"
+#include "memory_arena.hpp"
+#include "scratch_space.hpp"
+#include "MergeSort.hpp"
+
+/*
+ * Claves de los tipos de registro. Cada una ofrece:
+ *   less(a, b): orden de los registros según su clave.
+ *   prefix(r): primeros 64 bits de la clave como entero sin signo, con el mismo orden
+ *     (prefix(a) < prefix(b) implica less(a, b)).
+ *   exact_prefix: si el prefijo es la clave completa (prefijos iguales, claves iguales).
+ */
+
+// Enteros de 64 bits: el registro es la clave (el caso de MergeSort y QuickSort)
+struct Int64Key {
+    static bool less(int64_t a, int64_t b) { return a < b; }
+    static uint64_t prefix(int64_t a) { return (uint64_t)a ^ (1ULL << 63); }
+    static constexpr bool exact_prefix = true;
+};
+
+// Registro de 16 bytes: clave y número de fila
+struct KeyRowRecord {
+    int64_t key;
+    int64_t rowid;
+};
+
+struct KeyRowKey {
+    static bool less(const KeyRowRecord& a, const KeyRowRecord& b) { return a.key < b.key; }
+    static uint64_t prefix(const KeyRowRecord& r) { return (uint64_t)r.key ^ (1ULL << 63); }
+    static constexpr bool exact_prefix = true;
+};
+
+// Bytes de la clave de un registro gensort
+const int GENSORT_KEY_BYTES = 10;
+
+// Registro de 100 bytes al estilo gensort: 10 bytes de clave (bytes sin signo) y 90 de carga
+struct GensortRecord {
+    uint8_t bytes[100];
+};
+
+struct GensortKey {
+    static bool less(const GensortRecord& a, const GensortRecord& b) {
+        return memcmp(a.bytes, b.bytes, GENSORT_KEY_BYTES) < 0;
+    }
+    static uint64_t prefix(const GensortRecord& r) {
+        uint64_t p;
+        memcpy(&p, r.bytes, sizeof(p));
+        return __builtin_bswap64(p);
+    }
+    static constexpr bool exact_prefix = false;
+};
+
+// Cómo se ordena cada trozo en memoria
+enum class RecordSortMode {
+    AUTO,        // KEY_POINTER si el registro mide al menos KEY_POINTER_MIN_RECORD bytes
+    RECORDS,     // Se ordenan los registros completos
+    KEY_POINTER  // Se ordenan pares (prefijo de clave, índice) y los registros se copian una vez
+};
+
+// Tamaño de registro desde el cual AUTO ordena pares clave-índice
+const size_t KEY_POINTER_MIN_RECORD = 32;
+
+// Bytes de cada buffer de lectura o escritura de registros (se redondea a registros completos)
+const int64_t RECORD_BUFFER_BYTES = 16 * BLOCK_SIZE;
+
+// Par del ordenamiento clave-puntero
+struct KeyIndex {
+    uint64_t prefix;
+    uint32_t index;
+};
+
+/**
+ * Retorna los bloques de disco que ocupan `bytes` bytes.
+ */
+inline long record_blocks(int64_t bytes) {
+    return (bytes + BLOCK_SIZE - 1) / BLOCK_SIZE;
+}
+
+/**
+ * Indica si un trozo de registros de tipo R se ordena con pares clave-índice.
+ */
+template <typename R>
+inline bool uses_key_pointer(RecordSortMode mode) {
+    if (mode == RecordSortMode::AUTO) return sizeof(R) >= KEY_POINTER_MIN_RECORD;
+    return mode == RecordSortMode::KEY_POINTER;
+}
+
+/**
+ * Ordena n registros en memoria y los escribe en orden al final de `out`.
+ *
+ * @param records Registros a ordenar.
+ * @param n Cantidad de registros.
+ * @param pairs Espacio para n pares clave-índice, o nullptr para ordenar los registros
+ *              completos.
+ * @param out_buf Buffer de salida de `out_records` registros (solo con pares).
+ * @param out Archivo donde se escriben los registros ordenados.
+ *
+ * Con pares, se ordenan los prefijos de 64 bits con su índice (16 bytes por registro, sin
+ * importar el tamaño del registro), desempatando con la clave completa si el prefijo no
+ * la contiene entera; después cada registro se copia una sola vez, en orden, al buffer
+ * de salida. Así el ordenamiento mueve pares chicos en vez de registros de 100 bytes.
+ */
+template <typename R, typename KeyOf>
+inline void sort_and_write_records(R* records, int64_t n, KeyIndex* pairs, R* out_buf, int64_t out_records, BlockFile* out) {
+    if (!pairs) {
+        std::sort(records, records + n, [](const R& a, const R& b) { return KeyOf::less(a, b); });
+        out->write(records, n * sizeof(R));
+        write_io += record_blocks(n * sizeof(R));
+        return;
+    }
+
+    for (int64_t i = 0; i < n; i++) pairs[i] = {KeyOf::prefix(records[i]), (uint32_t)i};
+    std::sort(pairs, pairs + n, [records](const KeyIndex& a, const KeyIndex& b) {
+        if (a.prefix != b.prefix) return a.prefix < b.prefix;
+        if constexpr (KeyOf::exact_prefix) return false;
+        else return KeyOf::less(records[a.index], records[b.index]);
+    });
+    for (int64_t i = 0; i < n; i += out_records) {
+        int64_t m = std::min(out_records, n - i);
+        for (int64_t j = 0; j < m; j++) out_buf[j] = records[pairs[i + j].index];
+        out->write(out_buf, m * sizeof(R));
+    }
+    write_io += record_blocks(n * sizeof(R));
+}
+
+/**
+ * Forma runs ordenados de registros: trozos tan grandes como quepan en `memory_arena`.
+ *
+ * @param input_file Archivo de entrada.
+ * @param output_file Salida, que se escribe directamente si toda la entrada cabe en un trozo.
+ * @param N Cantidad de registros.
+ * @param key_pointer Si cada trozo se ordena con pares clave-índice.
+ *
+ * @return Nombres de los runs en el espacio temporal (vacío si se escribió la salida).
+ */
+template <typename R, typename KeyOf>
+inline std::vector<std::string> generate_record_runs(const std::string& input_file, const std::string& output_file, int64_t N,
+                                                     bool key_pointer) {
+    std::vector<std::string> runs;
+    auto f = block_device().open(input_file, OpenMode::READ);
+
+    ArenaScope scope;
+    auto elements = [](int64_t bytes) { return (bytes + ELEMENT_SIZE - 1) / ELEMENT_SIZE; };
+
+    // El buffer de salida de los pares ocupa a lo más un cuarto de la memoria
+    int64_t capacity = memory_arena.available() * ELEMENT_SIZE;
+    int64_t out_bytes = std::min<int64_t>(RECORD_BUFFER_BYTES, capacity / 4);
+    int64_t out_records = key_pointer ? std::max<int64_t>(1, out_bytes / sizeof(R)) : 0;
+    int64_t budget = capacity - elements(out_records * sizeof(R)) * ELEMENT_SIZE;
+    int64_t per_record = sizeof(R) + (key_pointer ? sizeof(KeyIndex) : 0);
+    int64_t chunk = std::min<int64_t>(N, std::max<int64_t>(budget / per_record - 2, 1));
+    if (key_pointer) chunk = std::min<int64_t>(chunk, UINT32_MAX);
+
+    R* records = (R*)memory_arena.allocate(elements(chunk * sizeof(R)));
+    KeyIndex* pairs = key_pointer ? (KeyIndex*)memory_arena.allocate(elements(chunk * sizeof(KeyIndex))) : nullptr;
+    R* out_buf = key_pointer ? (R*)memory_arena.allocate(elements(out_records * sizeof(R))) : nullptr;
+
+    if (N == 0) block_device().open(output_file, OpenMode::CREATE);
+
+    for (int64_t done = 0; done < N; done += chunk) {
+        int64_t n = std::min(chunk, N - done);
+        f->read(records, n * sizeof(R));
+        read_io += record_blocks(n * sizeof(R));
+
+        std::unique_ptr<BlockFile> out;
+        if (n == N) {
+            out = block_device().open(output_file, OpenMode::CREATE);
+        } else {
+            std::string run_name = input_file + "_run_" + std::to_string(runs.size());
+            out = create_scratch(run_name, {});
+            runs.push_back(run_name);
+        }
+        sort_and_write_records<R, KeyOf>(records, n, pairs, out_buf, out_records, out.get());
+    }
+    return runs;
+}
+
+/**
+ * Mezcla runs de registros ordenados en `out`.
+ *
+ * @param input_files Runs a mezclar.
+ * @param out Archivo de salida.
+ * @param buf_records Registros por buffer (uno por run y uno de salida, de `memory_arena`).
+ *
+ * Usa un heap de runs ordenado por el prefijo de 64 bits del registro actual de cada
+ * run, que se guarda aparte para comparar sin leer el registro; solo con prefijos
+ * iguales (y una clave más larga que el prefijo) se compara la clave completa.
+ */
+template <typename R, typename KeyOf>
+inline void merge_record_files(const std::vector<std::string>& input_files, BlockFile* out, int64_t buf_records) {
+    size_t k = input_files.size();
+    ArenaScope scope;
+    auto elements = [](int64_t bytes) { return (bytes + ELEMENT_SIZE - 1) / ELEMENT_SIZE; };
+
+    std::vector<std::unique_ptr<BlockFile>> inputs(k);
+    std::vector<R*> buffers(k);
+    std::vector<int64_t> pos(k, 0), size(k, 0);
+    std::vector<uint64_t> prefix(k);
+    R* out_buf = (R*)memory_arena.allocate(elements(buf_records * sizeof(R)));
+    int64_t out_size = 0;
+
+    auto refill = [&](size_t i) {
+        size_t bytes = inputs[i]->read(buffers[i], buf_records * sizeof(R));
+        read_io += record_blocks(bytes);
+        size[i] = bytes / sizeof(R);
+        pos[i] = 0;
+        if (size[i] > 0) prefix[i] = KeyOf::prefix(buffers[i][0]);
+        return size[i] > 0;
+    };
+
+    auto greater = [&](size_t a, size_t b) {
+        if (prefix[a] != prefix[b]) return prefix[a] > prefix[b];
+        if constexpr (KeyOf::exact_prefix) return a > b;
+        else return KeyOf::less(buffers[b][pos[b]], buffers[a][pos[a]]);
+    };
+    std::priority_queue<size_t, std::vector<size_t>, decltype(greater)> heap(greater);
+
+    for (size_t i = 0; i < k; i++) {
+        inputs[i] = scratch_device().open(input_files[i], OpenMode::READ);
+        buffers[i] = (R*)memory_arena.allocate(elements(buf_records * sizeof(R)));
+        if (refill(i)) heap.push(i);
+    }
+
+    while (!heap.empty()) {
+        size_t i = heap.top();
+        heap.pop();
+        out_buf[out_size++] = buffers[i][pos[i]++];
+        if (out_size == buf_records) {
+            out->write(out_buf, out_size * sizeof(R));
+            write_io += record_blocks(out_size * sizeof(R));
+            out_size = 0;
+        }
+        if (pos[i] < size[i]) {
+            prefix[i] = KeyOf::prefix(buffers[i][pos[i]]);
+            heap.push(i);
+        } else if (refill(i)) {
+            heap.push(i);
+        }
+    }
+    if (out_size > 0) {
+        out->write(out_buf, out_size * sizeof(R));
+        write_io += record_blocks(out_size * sizeof(R));
+    }
+}
+
+/**
+ * Ordena un archivo de registros de tamaño fijo de tipo R según la clave KeyOf, con
+ * mergesort externo.
+ *
+ * @param input_file Archivo de entrada.
+ * @param output_file Archivo de salida.
+ * @param N Cantidad de registros.
+ * @param M_bytes Memoria disponible en bytes.
+ * @param a Aridad máxima de cada mezcla.
+ * @param mode Ordenamiento en memoria de cada trozo (ver RecordSortMode).
+ *
+ * La instancia de enteros de 64 bits (R = int64_t, KeyOf = Int64Key) se resuelve en
+ * compilación y llama a `mergesort_external`, así que conserva todo lo de ese camino
+ * (selección por reemplazo, mezcla con árbol de perdedores y E/S asíncrona). Para los
+ * demás tipos los runs son trozos de M bytes ordenados en memoria, en el espacio
+ * temporal, y se mezclan en pasadas de a lo más `a` vías con buffers de
+ * RECORD_BUFFER_BYTES (menos si no caben). Las I/Os se cuentan en bloques de BLOCK_SIZE
+ * bytes.
+ */
+template <typename R, typename KeyOf>
+inline void record_sort_external(const std::string& input_file, const std::string& output_file, int64_t N, int64_t M_bytes,
+                                 int64_t a, RecordSortMode mode = RecordSortMode::AUTO) {
+    static_assert(std::is_trivially_copyable_v<R>, "Los registros se leen y escriben como bytes");
+    if constexpr (std::is_same_v<R, int64_t> && std::is_same_v<KeyOf, Int64Key>) {
+        mergesort_external(input_file, output_file, N, M_bytes / ELEMENT_SIZE, a);
+        return;
+    } else {
+        // La mezcla necesita al menos dos buffers de entrada y uno de salida de un registro
+        if (N > 0 && M_bytes < 3 * (int64_t)(sizeof(R) + ELEMENT_SIZE)) {
+            fprintf(stderr, "[ERROR] Memoria insuficiente: se necesitan al menos %ld bytes\n",
+                    (long)(3 * (sizeof(R) + ELEMENT_SIZE)));
+            exit(1);
+        }
+        memory_arena.init(M_bytes / ELEMENT_SIZE);
+        read_io = 0;
+        write_io = 0;
+
+        ScratchScope scratch(input_file);
+        std::vector<std::string> runs;
+        {
+            PhaseTimer phase("formacion_runs");
+            runs = generate_record_runs<R, KeyOf>(input_file, output_file, N, uses_key_pointer<R>(mode));
+        }
+        total_runs = runs.size();
+        total_merge_passes = 0;
+
+        if (!runs.empty()) {
+            // Un buffer por run más uno de salida
+            int64_t capacity = memory_arena.available() * ELEMENT_SIZE;
+            int64_t buf_records = std::max<int64_t>(1, RECORD_BUFFER_BYTES / sizeof(R));
+            if (capacity / (3 * buf_records * (int64_t)sizeof(R)) < 1) buf_records = std::max<int64_t>(1, capacity / (3 * sizeof(R)) - 1);
+            a = std::max<int64_t>(2, std::min<int64_t>(a, capacity / (buf_records * sizeof(R) + ELEMENT_SIZE) - 1));
+
+            while (true) {
+                PhaseTimer phase("mezcla", total_merge_passes);
+                if ((int64_t)runs.size() <= a) {
+                    auto out = block_device().open(output_file, OpenMode::CREATE);
+                    merge_record_files<R, KeyOf>(runs, out.get(), buf_records);
+                    for (const auto& run : runs) scratch_device().remove(run);
+                    total_merge_passes++;
+                    break;
+                }
+                std::vector<std::string> next;
+                for (size_t i = 0; i < runs.size(); i += a) {
+                    std::vector<std::string> group(runs.begin() + i, runs.begin() + std::min(runs.size(), i + (size_t)a));
+                    std::string merged = output_file + "_pass_" + std::to_string(total_merge_passes) + "_" + std::to_string(next.size());
+                    auto out = create_scratch(merged, group);
+                    merge_record_files<R, KeyOf>(group, out.get(), buf_records);
+                    for (const auto& run : group) scratch_device().remove(run);
+                    next.push_back(merged);
+                }
+                runs = next;
+                total_merge_passes++;
+            }
+        }
+
+        total_read_io += read_io;
+        total_write_io += write_io;
+    }
+}
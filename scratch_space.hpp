@@ -0,0 +1,444 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <algorithm>
+#include <sys/statvfs.h>
+
+#include "sort_common.hpp"
+#include "block_device.hpp"
+
+// Tamaño del primer extent de cada archivo temporal; los siguientes se duplican
+const int64_t SCRATCH_EXTENT_MIN = 64 * 1024;
+
+// Clases de tamaño de extent: de SCRATCH_EXTENT_MIN a SCRATCH_EXTENT_MIN << (clases - 1) (4 MB)
+const int SCRATCH_EXTENT_CLASSES = 7;
+
+// El archivo de espacio temporal se reserva (fallocate) de a este tamaño
+const int64_t SCRATCH_RESERVE_STEP = 64LL << 20;
+
+// Criterio para elegir en qué directorio de espacio temporal va cada archivo temporal
+enum class ScratchPolicy {
+    ROUND_ROBIN,  // Por turnos
+    FREE_SPACE    // El que tiene más espacio libre
+};
+
+// Directorios de espacio temporal (vacío: junto a la entrada) y criterio para repartir
+inline std::vector<std::string> scratch_dirs;
+inline ScratchPolicy scratch_policy = ScratchPolicy::ROUND_ROBIN;
+
+/**
+ * Interpreta la lista de directorios de espacio temporal: "<dir>[,<dir>...]", con un
+ * prefijo opcional "rr:" (por turnos, por defecto) o "space:" (por espacio libre).
+ *
+ * @return false si la lista está vacía.
+ */
+inline bool parse_scratch_dirs(const std::string& spec) {
+    std::string list = spec;
+    scratch_policy = ScratchPolicy::ROUND_ROBIN;
+    if (list.rfind("rr:", 0) == 0) {
+        list = list.substr(3);
+    } else if (list.rfind("space:", 0) == 0) {
+        scratch_policy = ScratchPolicy::FREE_SPACE;
+        list = list.substr(6);
+    }
+    scratch_dirs.clear();
+    size_t start = 0;
+    while (start <= list.size()) {
+        size_t comma = list.find(',', start);
+        if (comma == std::string::npos) comma = list.size();
+        std::string dir = list.substr(start, comma - start);
+        while (dir.size() > 1 && dir.back() == '/') dir.pop_back();
+        if (!dir.empty()) scratch_dirs.push_back(dir);
+        start = comma + 1;
+    }
+    return !scratch_dirs.empty();
+}
+
+/**
+ * Espacio temporal de un ordenamiento: todos los runs y particiones viven en un archivo
+ * de espacio temporal por directorio (volumen), preasignado con fallocate, en vez de un
+ * archivo por run o partición.
+ *
+ * Es un BlockDevice: los algoritmos abren, borran y renombran sus archivos temporales
+ * por nombre como antes, pero los nombres y tamaños solo existen en memoria. Cada archivo
+ * temporal está entero en un volumen y es una lista de extents de su archivo de espacio
+ * temporal; el extent i mide SCRATCH_EXTENT_MIN << min(i, clases - 1), así que un archivo
+ * chico desperdicia poco y uno grande se lee en tramos contiguos de 4 MB. Al borrar un
+ * archivo sus extents vuelven a una lista libre por clase y volumen, y los reutiliza el
+ * siguiente que los pida; un archivo de espacio temporal solo crece cuando no hay
+ * extents libres de la clase.
+ *
+ * Con varios volúmenes cada archivo nuevo va a uno según `policy` (por turnos o al de
+ * más espacio libre), evitando si se puede los volúmenes de los archivos que se están
+ * leyendo (`create`): así una mezcla o una distribución lee de unos discos y escribe en
+ * otros. Los archivos de cada volumen comparten una cola de E/S (`io_queue`), de modo
+ * que IOEngine usa un hilo por disco.
+ *
+ * Los nombres que no son temporales (la entrada, la salida) pasan al BlockDevice de
+ * abajo, así que abrir para leer la entrada original funciona igual. Renombrar un
+ * archivo temporal a uno que no lo es no se puede sin copiarlo: retorna false.
+ *
+ * Constructor:
+ *   ScratchSpace(base, paths, policy): espacio temporal en los archivos `paths` de `base`
+ *     (uno por volumen); cada uno se crea al escribir en él el primer archivo temporal y
+ *     se borra al destruir el objeto.
+ *
+ * Métodos (además de los de BlockDevice, donde open(name, CREATE) es create(name, {})):
+ *   create(name, away_from): crea un archivo temporal en un volumen distinto de los de
+ *     los archivos temporales `away_from`, si queda alguno.
+ *   peak_bytes(): suma de los mayores tamaños que alcanzaron los archivos de espacio temporal.
+ *   contains(name): indica si `name` es un archivo temporal.
+ *   files_created(): cantidad de archivos temporales creados.
+ *   volumes_used(): cantidad de volúmenes en los que se escribió.
+ */
+class ScratchSpace : public BlockDevice {
+    struct Entry {
+        size_t volume = 0;
+        std::vector<int64_t> extents;  // Posición de cada extent en el archivo de espacio temporal
+        int64_t size = 0;
+        int64_t capacity = 0;
+    };
+
+    struct Volume {
+        std::string path;
+        std::unique_ptr<BlockFile> backing;
+        std::vector<int64_t> free_extents[SCRATCH_EXTENT_CLASSES];
+        int64_t end = 0, reserved = 0;
+    };
+
+    static int64_t extent_bytes(size_t i) {
+        return SCRATCH_EXTENT_MIN << std::min<size_t>(i, SCRATCH_EXTENT_CLASSES - 1);
+    }
+
+    // Extent que contiene la posición `offset` de un archivo temporal y dónde empieza
+    static size_t extent_of(int64_t offset, int64_t& start) {
+        const int64_t doubling_end = SCRATCH_EXTENT_MIN * ((1LL << (SCRATCH_EXTENT_CLASSES - 1)) - 1);
+        if (offset < doubling_end) {
+            size_t i = 63 - __builtin_clzll(offset / SCRATCH_EXTENT_MIN + 1);
+            start = SCRATCH_EXTENT_MIN * ((1LL << i) - 1);
+            return i;
+        }
+        int64_t largest = extent_bytes(SCRATCH_EXTENT_CLASSES - 1);
+        size_t i = SCRATCH_EXTENT_CLASSES - 1 + (offset - doubling_end) / largest;
+        start = doubling_end + (int64_t)(i - (SCRATCH_EXTENT_CLASSES - 1)) * largest;
+        return i;
+    }
+
+    class ScratchFile : public BlockFile {
+        ScratchSpace& space;
+        std::shared_ptr<Entry> entry;
+        Volume& volume;
+
+        // Recorre los tramos contiguos de [offset, offset + bytes) en el archivo de abajo
+        template <typename Op>
+        size_t each_piece(size_t bytes, int64_t offset, Op op) {
+            size_t done = 0;
+            while (done < bytes) {
+                int64_t start;
+                size_t i = extent_of(offset + done, start);
+                int64_t physical;
+                {
+                    std::lock_guard<std::mutex> lock(space.mtx);
+                    physical = entry->extents[i];
+                }
+                size_t piece = std::min<int64_t>(bytes - done, start + extent_bytes(i) - (offset + done));
+                size_t n = op(done, piece, physical + (offset + done - start));
+                done += n;
+                if (n < piece) break;
+            }
+            return done;
+        }
+
+    protected:
+        size_t do_read(void* buf, size_t bytes, int64_t offset) override {
+            int64_t available;
+            {
+                std::lock_guard<std::mutex> lock(space.mtx);
+                available = entry->size - offset;
+            }
+            if (available <= 0) return 0;
+            return each_piece(std::min<int64_t>(bytes, available), offset, [&](size_t done, size_t piece, int64_t pos) {
+                return volume.backing->read_at((char*)buf + done, piece, pos);
+            });
+        }
+
+        size_t do_write(const void* buf, size_t bytes, int64_t offset) override {
+            space.grow(*entry, offset + bytes, true);
+            return each_piece(bytes, offset, [&](size_t done, size_t piece, int64_t pos) {
+                return volume.backing->write_at((const char*)buf + done, piece, pos);
+            });
+        }
+
+    public:
+        ScratchFile(ScratchSpace& space, std::shared_ptr<Entry> entry)
+            : space(space), entry(std::move(entry)), volume(space.volumes[this->entry->volume]) {}
+
+        int64_t size() override {
+            std::lock_guard<std::mutex> lock(space.mtx);
+            return entry->size;
+        }
+
+        void truncate(int64_t bytes) override {
+            space.grow(*entry, bytes, false);
+            std::lock_guard<std::mutex> lock(space.mtx);
+            entry->size = bytes;
+        }
+
+        bool layered() const override { return true; }
+
+        const void* io_queue() const override { return &volume; }
+
+        BlockFile* resolve(int64_t offset, size_t bytes, bool for_write, int64_t& physical) override {
+            if (for_write) space.grow(*entry, offset + bytes, true);
+            int64_t start;
+            size_t i = extent_of(offset, start);
+            std::lock_guard<std::mutex> lock(space.mtx);
+            // Una lectura que pasa del final debe quedar corta: la hace do_read
+            if (offset + (int64_t)bytes > start + extent_bytes(i) || offset + (int64_t)bytes > entry->size) {
+                physical = offset;
+                return this;
+            }
+            physical = entry->extents[i] + (offset - start);
+            return volume.backing.get();
+        }
+    };
+
+    BlockDevice& base;
+    ScratchPolicy policy;
+    std::vector<Volume> volumes;
+    size_t next_volume = 0;
+    std::mutex mtx;
+    std::map<std::string, std::shared_ptr<Entry>> files;
+    int64_t created = 0;
+
+    // Agrega extents hasta que el archivo temporal tenga lugar para `bytes`; si
+    // `extend`, su tamaño pasa a ser al menos `bytes`
+    void grow(Entry& entry, int64_t bytes, bool extend) {
+        std::lock_guard<std::mutex> lock(mtx);
+        Volume& v = volumes[entry.volume];
+        while (entry.capacity < bytes) {
+            size_t cls = std::min<size_t>(entry.extents.size(), SCRATCH_EXTENT_CLASSES - 1);
+            int64_t extent;
+            if (!v.free_extents[cls].empty()) {
+                extent = v.free_extents[cls].back();
+                v.free_extents[cls].pop_back();
+            } else {
+                extent = v.end;
+                v.end += extent_bytes(cls);
+                if (v.end > v.reserved) {
+                    v.reserved = v.end + SCRATCH_RESERVE_STEP;
+                    v.backing->reserve(v.reserved);
+                }
+            }
+            entry.extents.push_back(extent);
+            entry.capacity += extent_bytes(entry.extents.size() - 1);
+        }
+        if (extend) entry.size = std::max(entry.size, bytes);
+    }
+
+    void release(Entry& entry) {
+        Volume& v = volumes[entry.volume];
+        for (size_t i = 0; i < entry.extents.size(); i++) {
+            v.free_extents[std::min<size_t>(i, SCRATCH_EXTENT_CLASSES - 1)].push_back(entry.extents[i]);
+        }
+        entry.extents.clear();
+        entry.capacity = entry.size = 0;
+    }
+
+    // Espacio libre en el directorio de un volumen (lo ya reservado con fallocate no cuenta)
+    static int64_t free_bytes(const Volume& v) {
+        size_t slash = v.path.find_last_of('/');
+        std::string dir = slash == std::string::npos ? "." : v.path.substr(0, std::max<size_t>(slash, 1));
+        struct statvfs st;
+        if (statvfs(dir.c_str(), &st) != 0) return 0;
+        return (int64_t)st.f_bavail * st.f_frsize;
+    }
+
+    // Volumen para un archivo nuevo, fuera de `avoid` si se puede
+    size_t choose_volume(const std::vector<char>& avoid) {
+        size_t n = volumes.size();
+        bool all_avoided = std::count(avoid.begin(), avoid.end(), 1) == (long)n;
+        auto allowed = [&](size_t v) { return all_avoided || !avoid[v]; };
+        if (policy == ScratchPolicy::FREE_SPACE) {
+            size_t best = n;
+            int64_t best_free = -1;
+            for (size_t v = 0; v < n; v++) {
+                if (!allowed(v)) continue;
+                int64_t available = free_bytes(volumes[v]);
+                if (available > best_free) {
+                    best = v;
+                    best_free = available;
+                }
+            }
+            return best;
+        }
+        for (size_t tries = 0; tries < n; tries++) {
+            size_t v = next_volume++ % n;
+            if (allowed(v)) return v;
+        }
+        return 0;
+    }
+
+public:
+    ScratchSpace(BlockDevice& base, const std::vector<std::string>& paths, ScratchPolicy policy = ScratchPolicy::ROUND_ROBIN)
+        : base(base), policy(policy), volumes(paths.size()) {
+        for (size_t v = 0; v < paths.size(); v++) volumes[v].path = paths[v];
+    }
+
+    ~ScratchSpace() override {
+        for (Volume& v : volumes) {
+            bool existed = v.backing != nullptr;
+            v.backing.reset();
+            if (existed) base.remove(v.path);
+        }
+    }
+
+    std::unique_ptr<BlockFile> create(const std::string& name, const std::vector<std::string>& away_from) {
+        std::lock_guard<std::mutex> lock(mtx);
+        std::vector<char> avoid(volumes.size(), 0);
+        for (const auto& other : away_from) {
+            auto it = files.find(other);
+            if (it != files.end()) avoid[it->second->volume] = 1;
+        }
+        auto it = files.find(name);
+        if (it != files.end()) {
+            release(*it->second);
+            files.erase(it);
+        }
+        auto entry = std::make_shared<Entry>();
+        entry->volume = choose_volume(avoid);
+        Volume& v = volumes[entry->volume];
+        if (!v.backing) v.backing = base.open(v.path, OpenMode::CREATE);
+        files.emplace(name, entry);
+        created++;
+        return std::make_unique<ScratchFile>(*this, entry);
+    }
+
+    std::unique_ptr<BlockFile> open(const std::string& name, OpenMode mode) override {
+        if (mode == OpenMode::CREATE) return create(name, {});
+        std::lock_guard<std::mutex> lock(mtx);
+        auto it = files.find(name);
+        if (it == files.end()) return base.open(name, mode);
+        return std::make_unique<ScratchFile>(*this, it->second);
+    }
+
+    void remove(const std::string& name) override {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            auto it = files.find(name);
+            if (it != files.end()) {
+                release(*it->second);
+                files.erase(it);
+                return;
+            }
+        }
+        base.remove(name);
+    }
+
+    bool rename(const std::string& from, const std::string& to) override {
+        std::lock_guard<std::mutex> lock(mtx);
+        auto it = files.find(from);
+        if (it == files.end()) return base.rename(from, to);
+        auto target = files.find(to);
+        if (target == files.end()) return false;
+        release(*target->second);
+        target->second = it->second;
+        files.erase(it);
+        return true;
+    }
+
+    void persist(const std::string& name) override { base.persist(name); }
+
+    std::string describe() const override { return base.describe(); }
+
+    int64_t peak_bytes() const {
+        int64_t total = 0;
+        for (const Volume& v : volumes) total += v.end;
+        return total;
+    }
+
+    bool contains(const std::string& name) {
+        std::lock_guard<std::mutex> lock(mtx);
+        return files.count(name) > 0;
+    }
+
+    int64_t files_created() const { return created; }
+
+    int64_t volumes_used() const {
+        return std::count_if(volumes.begin(), volumes.end(), [](const Volume& v) { return v.end > 0; });
+    }
+};
+
+inline std::unique_ptr<ScratchSpace>& scratch_space_ptr() {
+    static std::unique_ptr<ScratchSpace> space;
+    return space;
+}
+
+// Tamaño máximo, archivos creados y volúmenes usados del último espacio temporal, para el reporte
+inline int64_t scratch_peak_bytes = 0, scratch_files_created = 0, scratch_volumes_used = 0;
+
+/**
+ * Espacio temporal de un ordenamiento de `input_file`: un archivo en cada directorio de
+ * `scratch_dirs`, o uno junto a la entrada si no se eligieron directorios. Mientras el
+ * objeto existe, `scratch_device()` lo entrega; al destruirse se borran los archivos y
+ * se guardan sus estadísticas.
+ */
+class ScratchScope {
+public:
+    explicit ScratchScope(const std::string& input_file) {
+        std::vector<std::string> paths;
+        if (scratch_dirs.empty()) {
+            paths.push_back(input_file + "_scratch");
+        } else {
+            size_t slash = input_file.find_last_of('/');
+            std::string base_name = slash == std::string::npos ? input_file : input_file.substr(slash + 1);
+            for (const auto& dir : scratch_dirs) paths.push_back(dir + "/" + base_name + "_scratch");
+        }
+        scratch_space_ptr() = std::make_unique<ScratchSpace>(block_device(), paths, scratch_policy);
+    }
+
+    ~ScratchScope() {
+        scratch_peak_bytes = scratch_space_ptr()->peak_bytes();
+        scratch_files_created = scratch_space_ptr()->files_created();
+        scratch_volumes_used = scratch_space_ptr()->volumes_used();
+        scratch_space_ptr().reset();
+    }
+
+    ScratchScope(const ScratchScope&) = delete;
+    ScratchScope& operator=(const ScratchScope&) = delete;
+};
+
+/**
+ * Almacenamiento de los archivos temporales: el espacio temporal si hay uno preparado,
+ * o el almacenamiento elegido si no.
+ */
+inline BlockDevice& scratch_device() {
+    auto& space = scratch_space_ptr();
+    if (space) return *space;
+    return block_device();
+}
+
+/**
+ * Crea un archivo temporal, en un disco distinto de los de `away_from` si el espacio
+ * temporal tiene varios.
+ */
+inline std::unique_ptr<BlockFile> create_scratch(const std::string& name, const std::vector<std::string>& away_from) {
+    auto& space = scratch_space_ptr();
+    if (space) return space->create(name, away_from);
+    return block_device().open(name, OpenMode::CREATE);
+}
+
+/**
+ * Indica si `name` es un archivo del espacio temporal (y no, p. ej., la entrada).
+ */
+inline bool is_scratch_file(const std::string& name) {
+    auto& space = scratch_space_ptr();
+    return space && space->contains(name);
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint>
+
+// Tamaño de un entero de 64 bits (en bytes)
+const int64_t ELEMENT_SIZE = sizeof(int64_t);
+
+// Tamaño de un bloque de disco (en bytes)
+const int64_t BLOCK_SIZE = 4096;
+
+// Cantidad de elementos int64_t que caben en un bloque
+const int64_t ELEMENTS_PER_BLOCK = BLOCK_SIZE / ELEMENT_SIZE;
+
+// Contador global de operaciones de lecturas y escrituras totales realizadas en disco
+inline long total_read_io = 0, total_write_io = 0;
+
+// Contadores globales de operaciones de lectura/escritura en disco
+inline long read_io = 0, write_io = 0;